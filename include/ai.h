@@ -1,8 +1,34 @@
 #ifndef AI_H
 #define AI_H
 
-#define MAX_DEPTH 4  // Adjust based on desired strength/speed | 800 - 1000 elo as of now
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "moves.h"
+#include "bitboard.h"
+#include "tt.h"
+#include "pawns.h"
+#include "book.h"
+
+#define AI_MOVE_TIME_MS 1000  // Adjust based on desired strength/speed
+#define MAX_DEPTH 64          // Deepest iteration of iterative deepening
+#define MOVE_OVERHEAD_MS 30   // Kept back from the clock for communication lag
+#define MAX_SEARCH_THREADS 256
 #define INFINITY_SCORE 1000000
+#define MATE_BOUND (INFINITY_SCORE - MAX_PLY)  // Scores beyond this are mates
+#define KNOWN_WIN 20000  // Bitbase wins, below any mate score
+
+// Selective search
+#define NULL_MOVE_MIN_DEPTH 3     // Null moves are tried from this depth
+#define NULL_MOVE_REDUCTION 2     // Plus a ply for every 6 of depth
+#define LMR_MIN_DEPTH 3           // Late moves are reduced from this depth
+#define LMR_FULL_DEPTH_MOVES 3    // Moves searched to full depth before reductions start
+#define DELTA_MARGIN 200          // Quiescence: captures that cannot lift the score this close to alpha are skipped
+
+// Aspiration windows: from this depth an iteration first searches this far either side of the
+// expected score, doubling the window on the side that fails each time
+#define ASPIRATION_MIN_DEPTH 4
+#define ASPIRATION_WINDOW 60
 
 // Piece values for processing of AI
 #define PAWN_VALUE 100
@@ -13,16 +39,158 @@
 
 // Evaluation bonuses
 #define CONNECTED_ROOKS_BONUS 30  
+#define KING_ZONE_ATTACK_PENALTY 8  // Per square next to the king hit by an enemy piece
+#define HANGING_PIECE_PENALTY 30    // Per piece the opponent wins material by taking
+
+// Squares attacked by each side, computed once per evaluated position and shared by the terms
+typedef struct {
+    Bitboard byType[2][6];  // [color][piece type]
+    Bitboard all[2];
+    Bitboard kingZone[2];   // King square and its neighbours
+    int mobility[2];        // Squares the pieces reach that are free of own pieces and enemy pawn attacks
+} AttackInfo;
+
+// Zero means no limit; with no limit at all the search runs to MAX_DEPTH
+typedef struct {
+    int depth;
+    uint64_t nodes;
+    int moveTime;      // Milliseconds for this move
+    int time[2];       // Remaining clock per color in milliseconds
+    int increment[2];
+    int movesToGo;     // Moves until the next time control, 0 if sudden death
+    int infinite;      // Ignore the time limits
+    volatile int *stop;  // Optional flag another thread sets to end the search
+} SearchLimits;
+
+// Which selective techniques the search uses, all on by default
+typedef struct {
+    int nullMove;            // Null-move pruning
+    int lateMoveReductions;
+} SearchOptions;
+
+// Search instrumentation, compiled in with "make STATS=1". Without SEARCH_STATS the counters
+// are never touched: SEARCH_STAT() drops the statement and the structs stay zero.
+#ifdef SEARCH_STATS
+#define SEARCH_STAT(statement) statement
+#else
+#define SEARCH_STAT(statement)
+#endif
+
+// Counted per thread and summed over threads; the iterations are the main thread's
+typedef struct {
+    uint64_t nodes;              // pvSearch nodes
+    uint64_t qnodes;             // Quiescence nodes
+    uint64_t plyNodes[MAX_PLY];  // Both kinds by distance from the root
+    uint64_t betaCutoffs;
+    uint64_t firstMoveCutoffs;   // ... by the first move searched
+    uint64_t ttProbes;
+    uint64_t ttHits;
+    uint64_t ttStores;
+    uint64_t nullMoves;          // Null-move searches
+    uint64_t nullMoveCutoffs;    // ... that failed high
+    uint64_t reductions;         // Late moves searched to reduced depth
+    uint64_t reSearches;         // ... that beat alpha and were searched again at full depth
+    int iterations;                          // Completed
+    uint64_t iterationNodes[MAX_DEPTH + 1];  // [depth]: nodes of all threads in that iteration
+    long long iterationMs[MAX_DEPTH + 1];    // [depth]: time that iteration took
+} SearchStats;
+
+// Reported by the main search thread after every completed iteration
+typedef struct {
+    int depth;
+    int score;          // From the side to move, mates as +-(INFINITY_SCORE - plies)
+    uint64_t nodes;
+    long long timeMs;
+    int pvLength;
+    Move pv[MAX_DEPTH];
+    SearchStats stats;  // Whole search so far, all threads (SEARCH_STATS builds only)
+} SearchInfo;
+
+typedef void (*SearchInfoCallback)(const SearchInfo *info, void *data);
+
+struct Searcher;
+
+// Everything one search thread owns: its copy of the position, move ordering and pawn table.
+// Lazy SMP: every thread searches the same root and they share only the transposition table.
+// Thread 0 is the main thread whose move is played.
+typedef struct {
+    struct Searcher *searcher;
+    pthread_t handle;
+    int id;
+    Position pos;
+    uint64_t nodes;
+    Move bestMove;
+    int bestScore;
+    int rootInBitbase;             // Bitbase wins are searched out to mate instead of cut off
+    SearchStats stats;
+    Move killerMoves[MAX_PLY][2];  // Quiet moves that caused a cutoff, two per ply
+
+    // Triangular PV table: row ply holds the best line found from that ply in the node being
+    // searched there. Row 0 is the root's line, kept in pv once the iteration completes.
+    Move pvTable[MAX_PLY][MAX_PLY];
+    int pvTableLength[MAX_PLY];
+    Move pv[MAX_PLY];              // Line of the last completed iteration
+    int pvLength;
+    int followPV;                  // The node about to be searched lies on pv
+    int historyTable[2][64][64];   // [color][from][to]
+    PawnTable pawnTable;           // Kept from one search to the next
+} SearchThread;
+
+// One engine instance. Searchers share nothing, so a process can run any number of them side
+// by side. Set up with initSearcher() and released with freeSearcher().
+typedef struct Searcher {
+    TranspositionTable table;
+    int hashMegabytes;
+    int threadCount;
+    SearchThread *threads[MAX_SEARCH_THREADS];  // Allocated when first used
+    SearchInfoCallback infoCallback;
+    void *infoData;
+    SearchOptions options;
+    FILE *statsOutput;  // Gets a JSON line of SearchStats after every search, if set
+
+    // The search in progress, read-only while the threads run
+    SearchLimits limits;
+    int maxDepth;
+    long long startMs;
+    long long softTimeLimitMs;  // No new iteration is started after this
+    long long hardTimeLimitMs;  // The running iteration is abandoned after this
+    volatile int stop;
+} Searcher;
+
+// A game against the engine: the position and the engine that plays it
+typedef struct {
+    Position position;
+    Searcher searcher;
+    const PolyglotBook *book;  // May be NULL, shared read-only between games
+} GameState;
+
+void initSearcher(Searcher *searcher);
+void freeSearcher(Searcher *searcher);
+void initSearchLimits(SearchLimits *searchLimits);
+int searchPosition(Searcher *searcher, const Position *root, const SearchLimits *searchLimits,
+                   Move *bestMove, int *bestScore);
+uint64_t getSearchNodes(const Searcher *searcher);
+void getSearchStats(const Searcher *searcher, SearchStats *stats);
+double effectiveBranchingFactor(const SearchStats *stats);
+void writeSearchStats(FILE *output, const SearchStats *stats);
+void setSearchStatsOutput(Searcher *searcher, FILE *output);
+void setSearchThreads(Searcher *searcher, int threads);
+void setSearchInfoCallback(Searcher *searcher, SearchInfoCallback callback, void *data);
+void clearSearchTables(Searcher *searcher);
+void setHashSize(Searcher *searcher, int megabytes);
+
+void initGame(GameState *game, const PolyglotBook *book);
+void freeGame(GameState *game);
+int getAIMove(GameState *game, Move *bestMove);
 
-int getAIMove(int *fromX, int *fromY, int *toX, int *toY);
-int evaluatePosition(void);
-int minimax(int depth, int alpha, int beta, int maximizing);
-void recordMove(int fromX, int fromY, int toX, int toY);
-int getMoveCount(); 
-int evaluateKingSafety();
-int evaluatePieceCoordination();
-int evaluateConnectedRooks();  
-int evaluatePawnStructure();   
-void loadOpenings(void);
+int evaluatePosition(const Position *pos, PawnTable *pawnTable);
+void computeAttackInfo(const Position *pos, AttackInfo *info);
+int evaluateKingSafety(const Position *pos, const AttackInfo *info);
+int evaluatePieceCoordination(const Position *pos, const AttackInfo *info);
+int evaluateMobility(const AttackInfo *info);
+int evaluateHangingPieces(const Position *pos, const AttackInfo *info);
+int evaluateCenterControl(const Position *pos, const AttackInfo *info);
+int evaluateConnectedRooks(const Position *pos);
+int evaluatePawnStructure(const Position *pos, PawnTable *pawnTable);
 
 #endif
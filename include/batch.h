@@ -0,0 +1,24 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+#include "ai.h"
+
+#define BATCH_DEFAULT_DEPTH 6    // Used when neither the options nor the position set a limit
+#define BATCH_DEFAULT_HASH_MB 4  // Per worker; small, since it is cleared for every position
+
+typedef struct {
+    int workers;          // Positions analysed at once, each on its own single-threaded searcher
+    int hashMegabytes;    // Per worker
+    SearchLimits limits;  // Defaults that "depth", "nodes" and "movetime" operations override
+    SearchOptions search;
+    FILE *statsOutput;    // If not NULL, gets the SearchStats of every position
+} BatchOptions;
+
+void initBatchOptions(BatchOptions *options);
+
+// Analyses every FEN or EPD line of input and writes one JSON object per line to output, in
+// input order. Returns the number of positions read, or -1 if no worker could be started.
+long analyseBatch(FILE *input, FILE *output, const BatchOptions *options);
+
+#endif // BATCH_H
@@ -0,0 +1,16 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+
+#define BENCH_DEPTH 8     // Default depth for every position
+#define BENCH_HASH_MB 16
+
+// Searches the built-in positions one after another to a fixed depth on one thread, with
+// cleared tables for each and no book, and prints the total nodes, time and speed. The node
+// total is a signature of the search: it only changes when the search itself does.
+// statsOutput, if not NULL, gets the SearchStats of every search.
+// Returns 0 on success.
+int runBench(int depth, FILE *statsOutput);
+
+#endif // BENCH_H
@@ -0,0 +1,21 @@
+#ifndef BITBASE_H
+#define BITBASE_H
+
+#include "board.h"
+
+#define BITBASE_MAX_PIECES 4       // Kings included
+#define BITBASE_DIR "bitbases"
+
+// probeBitbase() results, from the side to move
+enum { BITBASE_NONE, BITBASE_WIN, BITBASE_DRAW, BITBASE_LOSS };
+
+// Maps the KQK, KRK, KPK and KBNK bitbases from dir. Missing ones are not probed, with a
+// notice on stderr; only generate builds them, writing all four to dir (created if need be).
+// Returns the number available.
+int initBitbases(const char *dir, int generate);
+void freeBitbases(void);
+
+// A single bit lookup once the material is known to be covered
+int probeBitbase(const Position *pos);
+
+#endif // BITBASE_H
@@ -0,0 +1,72 @@
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include <stdint.h>
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#define USE_PEXT
+#endif
+
+typedef uint64_t Bitboard;
+
+// Squares follow the board[x][y] layout: square = x * 8 + y, so a8 is 0 and h1 is 63
+#define SQUARE(x, y) ((x) * 8 + (y))
+#define SQUARE_X(sq) ((sq) >> 3)
+#define SQUARE_Y(sq) ((sq) & 7)
+#define BIT(sq) (1ULL << (sq))
+#define ROW_MASK(x) (0xFFULL << (8 * (x)))
+#define FILE_MASK(y) (0x0101010101010101ULL << (y))
+
+// Slider lookup: with PEXT the index is the extracted occupancy, otherwise a magic multiply
+typedef struct {
+    Bitboard mask;
+    Bitboard magic;
+    Bitboard *attacks;
+    int shift;
+} Magic;
+
+extern Bitboard knightAttacks[64];
+extern Bitboard kingAttacks[64];
+extern Bitboard pawnAttacks[2][64];     // [color][square], color 0 moves towards x = 0
+extern Bitboard betweenSquares[64][64]; // Squares strictly between two aligned squares
+extern Magic rookMagics[64];
+extern Magic bishopMagics[64];
+
+void initBitboards(void);
+
+static inline int popCount(Bitboard b) {
+    return __builtin_popcountll(b);
+}
+
+static inline int lsb(Bitboard b) {
+    return __builtin_ctzll(b);
+}
+
+static inline int popLsb(Bitboard *b) {
+    int sq = __builtin_ctzll(*b);
+    *b &= *b - 1;
+    return sq;
+}
+
+static inline unsigned magicIndex(const Magic *m, Bitboard occupied) {
+#ifdef USE_PEXT
+    return (unsigned)_pext_u64(occupied, m->mask);
+#else
+    return (unsigned)(((occupied & m->mask) * m->magic) >> m->shift);
+#endif
+}
+
+static inline Bitboard rookAttacks(int sq, Bitboard occupied) {
+    return rookMagics[sq].attacks[magicIndex(&rookMagics[sq], occupied)];
+}
+
+static inline Bitboard bishopAttacks(int sq, Bitboard occupied) {
+    return bishopMagics[sq].attacks[magicIndex(&bishopMagics[sq], occupied)];
+}
+
+static inline Bitboard queenAttacks(int sq, Bitboard occupied) {
+    return rookAttacks(sq, occupied) | bishopAttacks(sq, occupied);
+}
+
+#endif // BITBOARD_H
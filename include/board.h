@@ -1,20 +1,92 @@
 #ifndef BOARD_H
 #define BOARD_H
 
+#include "bitboard.h"
+
 #define SIZE 8
 #define EMPTY '.'
 
-extern char board[SIZE][SIZE];
-extern int currentPlayer;  
-extern int canCastleKingside[2];
-extern int canCastleQueenside[2];
-extern int lastPawnDoubleMove[2];
-extern int lastMoveWasDoubleJump;
-extern int fiftyMoveCounter;
-extern int moveHistory[1000][4];
-extern int moveCount;
-
-void initializeBoard();
-void displayBoard();
+#define MAX_PLY 128  // Deepest line a search can play out
+
+#define START_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+
+// Piece type indices for the bitboards
+enum { PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING };
+
+typedef uint16_t Move;  // Encoded as described in moves.h
+
+// Everything doMove() overwrites that undoMove() cannot recompute
+typedef struct {
+    Move move;
+    char captured;
+    int canCastleKingside[2];
+    int canCastleQueenside[2];
+    int lastPawnDoubleMove[2];
+    int lastMoveWasDoubleJump;
+    int fiftyMoveCounter;
+    uint64_t positionKey;
+} UndoInfo;
+
+// Keys of the positions before the current one: the game so far plus the line being searched
+#define KEY_HISTORY_SIZE (1000 + MAX_PLY)
+
+// One game position with its history. Every function that looks at or changes the board takes
+// the position explicitly, so any number of games and searches can run side by side; a plain
+// struct copy hands a position to another thread.
+typedef struct {
+    char board[SIZE][SIZE];
+    int currentPlayer;
+    int canCastleKingside[2];
+    int canCastleQueenside[2];
+    int lastPawnDoubleMove[2];
+    int lastMoveWasDoubleJump;
+    int fiftyMoveCounter;
+    int moveCount;  // Plies played since the start of the game
+
+    uint64_t keyHistory[KEY_HISTORY_SIZE];
+    int keyHistoryCount;
+
+    // Preallocated undo records, one per ply of the line being searched
+    UndoInfo undoStack[MAX_PLY];
+    int undoCount;
+
+    // Bitboard mirror of board[][], kept in sync by setSquare()
+    Bitboard pieceBitboards[2][6];  // [color][piece type]
+    Bitboard colorBitboards[2];
+    Bitboard occupiedBitboard;
+
+    // Zobrist key of the position, updated incrementally like the bitboards
+    uint64_t positionKey;
+    uint64_t pawnKey;  // The same for the pawns alone
+
+    // Material plus piece-square score per color, [MIDGAME/ENDGAME][color], also kept by setSquare()
+    int pieceSquareScore[2][2];
+} Position;
+
+void initializeBoard(Position *pos);
+void displayBoard(const Position *pos);
+int setBoardFromFEN(Position *pos, const char *fen);
+void setSquare(Position *pos, int x, int y, char piece);
+void syncBitboards(Position *pos);
+
+// Lowercase pieces are color 0 (White), uppercase pieces are color 1 (Black)
+static inline int pieceColor(char piece) {
+    return piece >= 'A' && piece <= 'Z';
+}
+
+static inline int pieceType(char piece) {
+    switch (piece | 0x20) {  // ASCII lowercase
+        case 'p': return PAWN;
+        case 'n': return KNIGHT;
+        case 'b': return BISHOP;
+        case 'r': return ROOK;
+        case 'q': return QUEEN;
+        default:  return KING;
+    }
+}
+
+static inline char pieceChar(int color, int type) {
+    return (color ? "PNBRQK" : "pnbrqk")[type];
+}
 
 #endif // !BOARD_H
@@ -0,0 +1,38 @@
+#ifndef BOOK_H
+#define BOOK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "board.h"
+
+// Polyglot .bin books: 16-byte big-endian entries sorted by position key
+#define BOOK_ENTRY_SIZE 16
+#define POLYGLOT_RANDOM_COUNT 781
+
+typedef struct {
+    uint64_t key;
+    uint16_t move;    // Polyglot encoding, see encodeBookMove()
+    uint16_t weight;
+    uint32_t learn;
+} BookEntry;
+
+// A book file mapped into memory. Opening costs the same whatever the size of the book and
+// lookups are binary searches over the mapping; nothing is copied or parsed up front.
+typedef struct {
+    const unsigned char *data;
+    size_t size;
+    uint64_t count;  // Entries
+} PolyglotBook;
+
+uint64_t polyglotKey(const Position *pos);
+uint16_t encodeBookMove(Move move);
+Move decodeBookMove(const Position *pos, uint16_t bookMove);
+
+int openBook(PolyglotBook *book, const char *path);
+void closeBook(PolyglotBook *book);
+int bookEntries(const PolyglotBook *book, uint64_t key, BookEntry *entries, int maxEntries);
+Move probeBook(const PolyglotBook *book, const Position *pos, uint32_t random);
+
+void writeBookEntry(unsigned char *out, const BookEntry *entry);
+
+#endif // BOOK_H
@@ -0,0 +1,16 @@
+#ifndef MOVEGEN_H
+#define MOVEGEN_H
+
+#include "moves.h"
+
+// Pseudo-legal generation for the side to move; filter with isLegalMove()
+void generateCaptures(const Position *pos, MoveList *list);  // Captures, en passant and all promotions
+void generateQuiets(const Position *pos, MoveList *list);    // Everything else, including castling
+void generateMoves(const Position *pos, MoveList *list);
+
+int isPseudoLegalMove(const Position *pos, Move move);
+int isLegalMove(const Position *pos, Move move);
+void generateLegalMoves(const Position *pos, MoveList *list);
+Move findLegalMove(const Position *pos, int from, int to, int promotionType);
+
+#endif // MOVEGEN_H
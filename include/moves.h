@@ -1,26 +1,74 @@
 #ifndef MOVES_H
 #define MOVES_H
 
+#include <stdint.h>
 #include "board.h"
 
+// Move (declared in board.h) encoding: from square in bits 0-5, to square in bits 6-11,
+// promotion piece (type - KNIGHT) in bits 12-13 and the move kind in bits 14-15
+
+#define NO_MOVE 0
+#define MOVE_NORMAL     0
+#define MOVE_PROMOTION  (1 << 14)
+#define MOVE_EN_PASSANT (2 << 14)
+#define MOVE_CASTLING   (3 << 14)
+
+#define ENCODE_MOVE(from, to, kind) ((Move)((from) | ((to) << 6) | (kind)))
+#define ENCODE_PROMOTION(from, to, type) \
+    ((Move)((from) | ((to) << 6) | (((type) - KNIGHT) << 12) | MOVE_PROMOTION))
+#define MOVE_FROM(m) ((m) & 63)
+#define MOVE_TO(m) (((m) >> 6) & 63)
+#define MOVE_KIND(m) ((m) & (3 << 14))
+#define MOVE_PROMOTION_TYPE(m) ((((m) >> 12) & 3) + KNIGHT)
+
+#define MAX_MOVES 256
+
+typedef struct {
+    Move moves[MAX_MOVES];
+    int count;
+} MoveList;
+
 // Core move validation
-int isValidMove(int x1, int y1, int x2, int y2);
-void makeMove(int x1, int y1, int x2, int y2);
+int isValidMove(Position *pos, int x1, int y1, int x2, int y2);
+void makeMove(Position *pos, int x1, int y1, int x2, int y2);
+void makeMoveWithPromotion(Position *pos, int x1, int y1, int x2, int y2, char promotion);
 void convertNotation(const char *move, int *x1, int *y1, int *x2, int *y2);
-void switchTurn();
+void moveToString(Move move, char *str);  // str needs room for 6 chars
+void switchTurn(Position *pos);
+
+// Search make/unmake: plays any generated move and switches currentPlayer
+void doMove(Position *pos, Move move);
+void undoMove(Position *pos);
+void playMove(Position *pos, Move move);
+void doNullMove(Position *pos);
+void undoNullMove(Position *pos);
 
 // Special moves
-int isCastlingMove(int x1, int y1, int x2, int y2);
-int canCastle(int kingside, int playerColor);
-int isEnPassantMove(int x1, int y1, int x2, int y2);
-int isPawnPromotion(int x1, int y1, int x2, int y2);
+int isCastlingMove(const Position *pos, int x1, int y1, int x2, int y2);
+int canCastle(const Position *pos, int kingside, int playerColor);
+int isEnPassantMove(const Position *pos, int x1, int y1, int x2, int y2);
+int isPawnPromotion(const Position *pos, int x1, int y1, int x2, int y2);
+
+// Pieces of the given color attacking sq, with sliders blocked by occupied. Inline so that
+// callers passing a constant color get a copy without any color arithmetic.
+static inline Bitboard attackersTo(const Position *pos, int sq, Bitboard occupied, int color) {
+    const Bitboard *pieces = pos->pieceBitboards[color];
+
+    return (pawnAttacks[1 - color][sq] & pieces[PAWN]) |
+           (knightAttacks[sq] & pieces[KNIGHT]) |
+           (kingAttacks[sq] & pieces[KING]) |
+           (bishopAttacks(sq, occupied) & (pieces[BISHOP] | pieces[QUEEN])) |
+           (rookAttacks(sq, occupied) & (pieces[ROOK] | pieces[QUEEN]));
+}
 
 // Game state checks
-int isKingInCheck(int playerColor);
-int isCheckmate(int playerColor);
-int isStalemate(int playerColor);
-int isThreefoldRepetition();
-int isFiftyMoveDraw();
-int hasInsufficientMaterial();
+int isKingInCheck(const Position *pos, int playerColor);
+int isCheckmate(Position *pos, int playerColor);
+int isStalemate(Position *pos, int playerColor);
+int hasLegalMoves(Position *pos, int playerColor);
+int repetitionCount(const Position *pos);
+int isThreefoldRepetition(const Position *pos);
+int isFiftyMoveDraw(const Position *pos);
+int hasInsufficientMaterial(const Position *pos);
 
 #endif // MOVES_H 
@@ -0,0 +1,33 @@
+#ifndef PAWNS_H
+#define PAWNS_H
+
+#include <stdint.h>
+#include "board.h"
+
+#define PAWN_TABLE_ENTRIES 16384  // Per search thread, a power of two
+
+#define DOUBLED_PAWN_PENALTY 15   // Per pawn behind another of the same color on its file
+#define ISOLATED_PAWN_PENALTY 20
+
+// Everything that depends on the pawns alone. Scores favour color 1 like evaluatePosition().
+// File masks have bit y set for file y.
+typedef struct {
+    uint64_t key;
+    int score;                 // Doubled, isolated and passed pawns
+    uint8_t passedFiles[2];    // [color]
+    uint8_t isolatedFiles[2];
+    uint8_t doubledFiles[2];
+    int8_t shield[2][8];       // [color][king file]: pawns in front of a king on its home rows
+} PawnEntry;
+
+typedef struct {
+    PawnEntry *entries;
+    uint64_t mask;
+} PawnTable;
+
+int pawnTableInit(PawnTable *table);
+void pawnTableFree(PawnTable *table);
+const PawnEntry *probePawnTable(PawnTable *table, const Position *pos);
+void analysePawns(const Position *pos, PawnEntry *entry);
+
+#endif // PAWNS_H
@@ -0,0 +1,16 @@
+#ifndef PSQT_H
+#define PSQT_H
+
+#include "board.h"
+
+enum { MIDGAME, ENDGAME };
+
+#define MAX_PHASE 24  // Game phase with all pieces on the board
+
+// Material plus piece-square bonus of a piece on a square, [phase][color][piece type][square]
+extern int pieceSquareValues[2][2][6][64];
+
+void initPieceSquareTables(void);
+int gamePhase(const Position *pos);
+
+#endif // PSQT_H
@@ -0,0 +1,12 @@
+#ifndef SEE_H
+#define SEE_H
+
+#include "board.h"
+
+// Static exchange evaluation of a capture (or any move): both sides go on recapturing on its
+// target square with their cheapest attacker, each free to stop once that would cost them.
+// Returns the material the mover ends up winning in centipawns, negative if it loses.
+// Pins and checks are not considered.
+int staticExchange(const Position *pos, Move move);
+
+#endif // SEE_H
@@ -0,0 +1,39 @@
+#ifndef TT_H
+#define TT_H
+
+#include <stdint.h>
+#include "moves.h"
+
+#define DEFAULT_HASH_MB 16
+#define TT_BUCKET_SIZE 4
+
+enum { BOUND_NONE, BOUND_UPPER, BOUND_LOWER, BOUND_EXACT };
+
+// One slot. data packs the entry and check is key ^ data, so threads can read and write
+// without locks: an entry torn by concurrent writers fails the key check and is ignored.
+typedef struct {
+    uint64_t check;
+    uint64_t data;
+} TTEntry;
+
+typedef struct {
+    Move move;
+    int score;
+    int depth;
+    int bound;
+} TTData;
+
+typedef struct {
+    TTEntry *entries;
+    uint64_t bucketMask;  // Buckets of TT_BUCKET_SIZE entries, a power of two of them
+    int generation;
+} TranspositionTable;
+
+int ttInit(TranspositionTable *tt, int megabytes);
+void ttFree(TranspositionTable *tt);
+void ttClear(TranspositionTable *tt);
+void ttNewSearch(TranspositionTable *tt);
+int ttProbe(const TranspositionTable *tt, uint64_t key, TTData *data);
+void ttStore(TranspositionTable *tt, uint64_t key, Move move, int score, int depth, int bound);
+
+#endif // TT_H
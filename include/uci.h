@@ -0,0 +1,10 @@
+#ifndef UCI_H
+#define UCI_H
+
+#include <stdio.h>
+
+// Reads UCI commands from stdin until "quit" or end of input; threads is the initial Threads
+// option. statsOutput, if not NULL, gets the SearchStats of every search.
+int uciLoop(int threads, FILE *statsOutput);
+
+#endif // UCI_H
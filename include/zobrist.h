@@ -0,0 +1,17 @@
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+#include <stdint.h>
+#include "board.h"
+
+extern uint64_t pieceKeys[2][6][64];  // [color][piece type][square]
+extern uint64_t sideKey;              // Xored in when color 1 is to move
+extern uint64_t castleKingsideKeys[2];
+extern uint64_t castleQueensideKeys[2];
+extern uint64_t enPassantKeys[8];     // By file of the pawn that just advanced two squares
+
+void initZobrist(void);
+uint64_t computePositionKey(const Position *pos);
+uint64_t castlingAndEnPassantKey(const Position *pos);
+
+#endif // ZOBRIST_H
@@ -1,27 +1,21 @@
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
 #include <ctype.h>
 #include <math.h>
 #include <stdbool.h>
 #include <string.h>
+#include <time.h>
+#include <pthread.h>
 #include "ai.h"
 #include "board.h"
 #include "moves.h"
-
-// Move history to track repetition
-#define MOVE_HISTORY_SIZE 5
-char moveHistories[MOVE_HISTORY_SIZE][5];
-int moveHistoryCount = 0;
-
-// Penalty for repeating moves
-#define REPETITION_PENALTY 50
-
-// Piece-square tables and other constants remain unchanged
-const int pawnTable[64] = { /* ... */ };
-const int knightTable[64] = { /* ... */ };
-const int bishopTable[64] = { /* ... */ };
-const int kingTableMiddle[64] = { /* ... */ };
-const int kingTableEnd[64] = { /* ... */ };
+#include "movegen.h"
+#include "tt.h"
+#include "psqt.h"
+#include "pawns.h"
+#include "bitbase.h"
+#include "see.h"
 
 #define CENTER_CONTROL_WEIGHT 0.6
 #define DEVELOPMENT_WEIGHT 0.5
@@ -31,245 +25,151 @@ const int kingTableEnd[64] = { /* ... */ };
 #define MOBILITY_WEIGHT 0.4
 #define CONNECTED_ROOKS_BONUS 30
 
-#define MAX_OPENING_MOVES 1000
-#define MAX_MOVE_SEQUENCE 10
-
-typedef struct {
-    char moves[MAX_MOVE_SEQUENCE][5];
-    int moveCount;
-} MoveSequence;
-
-MoveSequence openingBook[MAX_OPENING_MOVES];
-int openingBookSize = 0;
-
-char lastMoves[MAX_MOVE_SEQUENCE][5];
-int lastMoveCount = 0;
-
-void loadOpenings() {
-    FILE *file = fopen("openings.txt", "r");
-    if (!file) {
-        perror("Failed to open opening book");
-        return;
-    }
+void initGame(GameState *game, const PolyglotBook *book) {
+    initializeBoard(&game->position);
+    initSearcher(&game->searcher);
+    game->book = book;
+}
 
-    char line[100];
-    while (fgets(line, sizeof(line), file)) {
-        if (openingBookSize >= MAX_OPENING_MOVES) break;
+void freeGame(GameState *game) {
+    freeSearcher(&game->searcher);
+}
 
-        line[strcspn(line, "\n")] = '\0';
+#define CONCAT_(a, b) a##b
+#define CONCAT(a, b) CONCAT_(a, b)
 
-        MoveSequence sequence;
-        sequence.moveCount = 0;
+#define US 0
+#define COLOR_SUFFIX White
+#include "eval_color.inc"
+#undef US
+#undef COLOR_SUFFIX
 
-        char *token = strtok(line, " ");
-        while (token != NULL && sequence.moveCount < MAX_MOVE_SEQUENCE) {
-            strncpy(sequence.moves[sequence.moveCount], token, 5);
-            sequence.moveCount++;
-            token = strtok(NULL, " ");
-        }
+#define US 1
+#define COLOR_SUFFIX Black
+#include "eval_color.inc"
+#undef US
+#undef COLOR_SUFFIX
 
-        openingBook[openingBookSize] = sequence;
-        openingBookSize++;
-    }
+void computeAttackInfo(const Position *pos, AttackInfo *info) {
+    computeFixedAttacksWhite(pos, info);
+    computeFixedAttacksBlack(pos, info);
+    computePieceAttacksWhite(pos, info);
+    computePieceAttacksBlack(pos, info);
+}
 
-    fclose(file);
+// Pawns sheltering the king, enemy pieces next to it and enemy attacks on the squares around it
+int evaluateKingSafety(const Position *pos, const AttackInfo *info) {
+    return kingSafetyBlack(pos, info) - kingSafetyWhite(pos, info);
 }
 
-void recordMove(int fromX, int fromY, int toX, int toY) {
-    // Update move history
-    if (moveHistoryCount >= MOVE_HISTORY_SIZE) {
-        for (int i = 1; i < MOVE_HISTORY_SIZE; i++) {
-            strncpy(moveHistories[i - 1], moveHistories[i], 5);
-        }
-        moveHistoryCount--;
-    }
+// Own pieces defended, counted once per kind of defender
+int evaluatePieceCoordination(const Position *pos, const AttackInfo *info) {
+    return pieceCoordinationBlack(pos, info) - pieceCoordinationWhite(pos, info);
+}
 
-    char move[25];
-    snprintf(move, sizeof(move), "%c%d%c%d", 
-             'a' + fromY, 8 - fromX,
-             'a' + toY, 8 - toX);
-    
-    strncpy(moveHistories[moveHistoryCount], move, 5);
-    moveHistories[moveHistoryCount][4] = '\0';
-    moveHistoryCount++;
-
-    // Update last moves for opening book
-    if (lastMoveCount >= MAX_MOVE_SEQUENCE) {
-        for (int i = 1; i < MAX_MOVE_SEQUENCE; i++) {
-            strncpy(lastMoves[i - 1], lastMoves[i], 5);
-        }
-        lastMoveCount--;
-    }
+// Pieces the opponent can win outright: its cheapest capture of them comes out ahead after
+// the exchange on the square
+int evaluateHangingPieces(const Position *pos, const AttackInfo *info) {
+    return (hangingPiecesWhite(pos, info) - hangingPiecesBlack(pos, info)) * HANGING_PIECE_PENALTY;
+}
 
-    strncpy(lastMoves[lastMoveCount], move, 5);
-    lastMoves[lastMoveCount][4] = '\0';
-    lastMoveCount++;
+int evaluateMobility(const AttackInfo *info) {
+    return info->mobility[1] - info->mobility[0];
 }
 
-int getMoveCount() {
-    return lastMoveCount;
+// Central squares occupied plus central squares attacked
+int evaluateCenterControl(const Position *pos, const AttackInfo *info) {
+    return centerControlBlack(pos, info) - centerControlWhite(pos, info);
 }
 
-int getOpeningMove(int *fromX, int *fromY, int *toX, int *toY) {
-    if (lastMoveCount >= MAX_MOVE_SEQUENCE) return 0;
-    
-    int matchingSequences[MAX_OPENING_MOVES];
-    int matchCount = 0;
-    
-    for (int i = 0; i < openingBookSize; i++) {
-        bool matches = true;
-        for (int j = 0; j < lastMoveCount; j++) {
-            if (j >= openingBook[i].moveCount || 
-                strcmp(lastMoves[j], openingBook[i].moves[j]) != 0) {
-                matches = false;
-                break;
-            }
-        }
-        
-        if (matches && openingBook[i].moveCount > lastMoveCount) {
-            matchingSequences[matchCount++] = i;
-        }
-    }
-    
-    if (matchCount > 0) {
-        int chosen = rand() % matchCount;
-        int seqIndex = matchingSequences[chosen];
-        char *nextMove = openingBook[seqIndex].moves[lastMoveCount];
-        
-        *fromY = nextMove[0] - 'a';
-        *fromX = '8' - nextMove[1];
-        *toY = nextMove[2] - 'a';
-        *toX = '8' - nextMove[3];
-        
-        if (isValidMove(*fromX, *fromY, *toX, *toY)) {
-            return 1;
-        }
-    }
-    
-    return 0;
+// Squares between sq and the centre, 0 to 6
+static int centerDistance(int sq) {
+    int x = SQUARE_X(sq), y = SQUARE_Y(sq);
+    return (x < 4 ? 3 - x : x - 4) + (y < 4 ? 3 - y : y - 4);
 }
 
-int evaluateKingSafety() {
-    int whiteKingSafety = 0;
-    int blackKingSafety = 0;
-    
-    int whiteKingX = -1, whiteKingY = -1;
-    int blackKingX = -1, blackKingY = -1;
-    
-    for (int i = 0; i < SIZE; i++) {
-        for (int j = 0; j < SIZE; j++) {
-            if (board[i][j] == 'K') { whiteKingX = i; whiteKingY = j; }
-            if (board[i][j] == 'k') { blackKingX = i; blackKingY = j; }
-        }
-    }
-    
-    for (int x = -1; x <= 1; x++) {
-        for (int y = -1; y <= 1; y++) {
-            int wx = whiteKingX + x;
-            int wy = whiteKingY + y;
-            int bx = blackKingX + x;
-            int by = blackKingY + y;
-            
-            if (wx >= 0 && wx < 8 && wy >= 0 && wy < 8) {
-                if (board[wx][wy] == 'P') whiteKingSafety += 10;
-                if (islower(board[wx][wy])) whiteKingSafety -= 20;
-            }
-            
-            if (bx >= 0 && bx < 8 && by >= 0 && by < 8) {
-                if (board[bx][by] == 'p') blackKingSafety += 10;
-                if (isupper(board[bx][by])) blackKingSafety -= 20;
-            }
-        }
-    }
-    
-    return whiteKingSafety - blackKingSafety;
+static int kingDistance(int a, int b) {
+    int dx = abs(SQUARE_X(a) - SQUARE_X(b)), dy = abs(SQUARE_Y(a) - SQUARE_Y(b));
+    return dx > dy ? dx : dy;
 }
 
-int evaluatePieceCoordination() {
-    int whiteCoordination = 0;
-    int blackCoordination = 0;
-    
-    for (int i = 0; i < SIZE; i++) {
-        for (int j = 0; j < SIZE; j++) {
-            char piece = board[i][j];
-            if (piece == EMPTY) continue;
-            
-            for (int x = 0; x < SIZE; x++) {
-                for (int y = 0; y < SIZE; y++) {
-                    if (isValidMove(i, j, x, y)) {
-                        char targetPiece = board[x][y];
-                        if (targetPiece != EMPTY) {
-                            if (isupper(piece) == isupper(targetPiece)) {
-                                if (isupper(piece)) whiteCoordination += 5;
-                                else blackCoordination += 5;
-                            }
-                        }
-                    }
-                }
-            }
-        }
+// A bitbase win is worth KNOWN_WIN plus progress towards the mate, so the search heads for it:
+// the weak king driven to the edge (to a corner of the bishop's colour in KBNK), the kings
+// close together and the pawn of KPK advanced
+static int evaluateBitbaseWin(const Position *pos, int strong) {
+    int weak = 1 - strong;
+    int strongKing = lsb(pos->pieceBitboards[strong][KING]);
+    int weakKing = lsb(pos->pieceBitboards[weak][KING]);
+    int score = KNOWN_WIN + (7 - kingDistance(strongKing, weakKing)) * 10;
+
+    if (pos->pieceBitboards[strong][PAWN]) {
+        int pawn = lsb(pos->pieceBitboards[strong][PAWN]);
+        score += (strong == 0 ? 7 - SQUARE_X(pawn) : SQUARE_X(pawn)) * 20;
+    } else if (pos->pieceBitboards[strong][BISHOP]) {
+        // Light squares are those with x + y even: a8 is row 0, file 0
+        int bishop = lsb(pos->pieceBitboards[strong][BISHOP]);
+        int corners[2][2] = { { SQUARE(0, 0), SQUARE(7, 7) }, { SQUARE(0, 7), SQUARE(7, 0) } };
+        int *ours = corners[(SQUARE_X(bishop) + SQUARE_Y(bishop)) & 1];
+        int a = kingDistance(weakKing, ours[0]), b = kingDistance(weakKing, ours[1]);
+        score += (7 - (a < b ? a : b)) * 20 + centerDistance(weakKing) * 10;
+    } else {
+        score += centerDistance(weakKing) * 20;
     }
-    
-    return whiteCoordination - blackCoordination;
+    return strong == 1 ? score : -score;
 }
 
-int evaluatePosition() {
-    int score = 0;
-    int whiteDevelopedPieces = 0, blackDevelopedPieces = 0;
-    int centerControl = 0;
-    
-    // Check for move repetition
-    if (moveHistoryCount >= 2) {
-        for (int i = 0; i < moveHistoryCount - 1; i++) {
-            if (strcmp(moveHistories[i], moveHistories[moveHistoryCount - 1]) == 0) {
-                score -= REPETITION_PENALTY;
-                break;
-            }
+// Positive when color 1 stands better. pawnTable caches the pawn structure and may be NULL.
+int evaluatePosition(const Position *pos, PawnTable *pawnTable) {
+    // Endings the bitbases cover are known exactly
+    if (popCount(pos->occupiedBitboard) <= BITBASE_MAX_PIECES) {
+        int result = probeBitbase(pos);
+        if (result == BITBASE_DRAW) return 0;
+        if (result != BITBASE_NONE) {
+            return evaluateBitbaseWin(pos, result == BITBASE_WIN ? pos->currentPlayer : 1 - pos->currentPlayer);
         }
     }
-    
-    for (int i = 0; i < SIZE; i++) {
-        for (int j = 0; j < SIZE; j++) {
-            char piece = board[i][j];
-            
-            if ((piece == 'N' || piece == 'B') && i != 7) whiteDevelopedPieces++;
-            if ((piece == 'n' || piece == 'b') && i != 0) blackDevelopedPieces++;
-            
-            if ((i == 3 || i == 4) && (j == 3 || j == 4)) {
-                if (isupper(piece)) centerControl++;
-                else if (islower(piece)) centerControl--;
-            }
-        }
-    }
-    
-    int moveCount = getMoveCount();
-    if (moveCount < 10) {
-        score += (whiteDevelopedPieces - blackDevelopedPieces) * 20;
-        
-        for (int i = 0; i < SIZE; i++) {
-            for (int j = 0; j < SIZE; j++) {
-                if (board[i][j] == 'Q' && i != 7) score -= 30;
-                if (board[i][j] == 'q' && i != 0) score += 30;
-            }
-        }
+
+    // Material and piece-square scores are kept up to date by every move; blend the
+    // midgame and endgame sums by how much material is left
+    int phase = gamePhase(pos);
+    int middlegame = pos->pieceSquareScore[MIDGAME][1] - pos->pieceSquareScore[MIDGAME][0];
+    int endgame = pos->pieceSquareScore[ENDGAME][1] - pos->pieceSquareScore[ENDGAME][0];
+    int score = (middlegame * phase + endgame * (MAX_PHASE - phase)) / MAX_PHASE;
+    AttackInfo attacks;
+
+    computeAttackInfo(pos, &attacks);
+
+    // Color 1 starts on row 0, color 0 on row 7
+    if (pos->moveCount < 10) {
+        Bitboard minors[2] = {
+            pos->pieceBitboards[0][KNIGHT] | pos->pieceBitboards[0][BISHOP],
+            pos->pieceBitboards[1][KNIGHT] | pos->pieceBitboards[1][BISHOP]
+        };
+        score += (popCount(minors[1] & ~ROW_MASK(0)) - popCount(minors[0] & ~ROW_MASK(7))) * 20;
+        score -= popCount(pos->pieceBitboards[1][QUEEN] & ~ROW_MASK(0)) * 30;
+        score += popCount(pos->pieceBitboards[0][QUEEN] & ~ROW_MASK(7)) * 30;
     }
     
-    int whiteKingSafety = evaluateKingSafety();
+    int whiteKingSafety = evaluateKingSafety(pos, &attacks);
     score += whiteKingSafety * KING_SAFETY_WEIGHT;
     
-    int coordination = evaluatePieceCoordination();
+    int coordination = evaluatePieceCoordination(pos, &attacks);
     score += coordination * PIECE_COORDINATION_WEIGHT;
+
+    score += evaluateMobility(&attacks) * MOBILITY_WEIGHT * 5;
     
-    score += evaluateConnectedRooks();
+    score += evaluateConnectedRooks(pos);
+
+    score += evaluateHangingPieces(pos, &attacks);
     
-    score += evaluatePawnStructure() * PAWN_STRUCTURE_WEIGHT;
+    score += evaluatePawnStructure(pos, pawnTable) * PAWN_STRUCTURE_WEIGHT;
     
-    score += centerControl * CENTER_CONTROL_WEIGHT * 10;
+    score += evaluateCenterControl(pos, &attacks) * CENTER_CONTROL_WEIGHT * 10;
     
     return score;
 }
 
-int evaluateConnectedRooks() {
+int evaluateConnectedRooks(const Position *pos) {
     int score = 0;
     bool whiteRooksConnected = false;
     bool blackRooksConnected = false;
@@ -280,9 +180,9 @@ int evaluateConnectedRooks() {
         bool blockedPieces = false;
         
         for (int j = 0; j < SIZE; j++) {
-            if (board[i][j] == 'R') whiteRookCount++;
-            else if (board[i][j] == 'r') blackRookCount++;
-            else if (board[i][j] != '.') blockedPieces = true;
+            if (pos->board[i][j] == 'R') whiteRookCount++;
+            else if (pos->board[i][j] == 'r') blackRookCount++;
+            else if (pos->board[i][j] != '.') blockedPieces = true;
         }
         
         if (whiteRookCount == 2 && !blockedPieces) whiteRooksConnected = true;
@@ -295,178 +195,898 @@ int evaluateConnectedRooks() {
     return score;
 }
 
-int evaluatePawnStructure() {
-    int score = 0;
-    
-    for (int j = 0; j < SIZE; j++) {
-        bool whitePawnOnFile = false;
-        bool blackPawnOnFile = false;
-        
-        for (int i = 0; i < SIZE; i++) {
-            if (board[i][j] == 'P') whitePawnOnFile = true;
-            if (board[i][j] == 'p') blackPawnOnFile = true;
-            
-            if (whitePawnOnFile && board[i][j] == 'P') score -= 15;
-            if (blackPawnOnFile && board[i][j] == 'p') score += 15;
-            
-            if ((j == 0 || board[i][j-1] != 'P') && 
-                (j == 7 || board[i][j+1] != 'P')) score -= 20;
-            if ((j == 0 || board[i][j-1] != 'p') && 
-                (j == 7 || board[i][j+1] != 'p')) score += 20;
-        }
+// Pawn structure comes from the pawn hash table of the searching thread; only the shield
+// in front of a king still on its home rows depends on anything else
+int evaluatePawnStructure(const Position *pos, PawnTable *pawnTable) {
+    PawnEntry analysis;
+    const PawnEntry *pawns;
+    int score;
+
+    if (pawnTable && pawnTable->entries) {
+        pawns = probePawnTable(pawnTable, pos);
+    } else {
+        analysePawns(pos, &analysis);
+        pawns = &analysis;
     }
-    
+
+    // One term per side, with its home rows fixed
+    int whiteKing = lsb(pos->pieceBitboards[0][KING]);
+    int blackKing = lsb(pos->pieceBitboards[1][KING]);
+    score = pawns->score;
+    if ((ROW_MASK(7) | ROW_MASK(6)) & BIT(whiteKing)) score -= pawns->shield[0][SQUARE_Y(whiteKing)];
+    if ((ROW_MASK(0) | ROW_MASK(1)) & BIT(blackKing)) score += pawns->shield[1][SQUARE_Y(blackKing)];
+
     return score;
 }
 
-int quiescence(int alpha, int beta, int depth) {
-    int standPat = evaluatePosition();
-    
-    if(standPat >= beta) return beta;
-    if(alpha < standPat) alpha = standPat;
-    if(depth <= -3) return alpha;
-    
-    for(int i = 0; i < SIZE; i++) {
-        for(int j = 0; j < SIZE; j++) {
-            char piece = board[i][j];
-            if(piece == EMPTY || 
-              (currentPlayer == 0 && !isupper(piece)) ||
-              (currentPlayer == 1 && isupper(piece))) continue;
-            
-            for(int x = 0; x < SIZE; x++) {
-                for(int y = 0; y < SIZE; y++) {
-                    if(isValidMove(i, j, x, y) && board[x][y] != EMPTY) {
-                        char tempDest = board[x][y];
-                        board[x][y] = board[i][j];
-                        board[i][j] = EMPTY;
-                        
-                        currentPlayer = !currentPlayer;
-                        int score = -quiescence(-beta, -alpha, depth - 1);
-                        currentPlayer = !currentPlayer;
-                        
-                        board[i][j] = board[x][y];
-                        board[x][y] = tempDest;
-                        
-                        if(score >= beta) return beta;
-                        if(score > alpha) alpha = score;
-                    }
+static long long currentTimeMs(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+// Count the node and, every few thousand nodes, check whether a limit was reached
+static void countNode(SearchThread *thread) {
+    Searcher *searcher = thread->searcher;
+
+    if ((++thread->nodes & 1023) != 0) return;
+
+    if (searcher->limits.stop && *searcher->limits.stop) searcher->stop = 1;
+    if (searcher->limits.nodes && getSearchNodes(searcher) >= searcher->limits.nodes) searcher->stop = 1;
+    if (searcher->hardTimeLimitMs && currentTimeMs() - searcher->startMs >= searcher->hardTimeLimitMs) {
+        searcher->stop = 1;
+    }
+}
+
+// Spend a share of the remaining clock: the remaining time split over the moves still to play
+// plus most of the increment, and never more than half the clock in one move
+static void allocateTime(Searcher *searcher, int us) {
+    const SearchLimits *limits = &searcher->limits;
+    long long soft = 0, hard = 0;
+
+    if (limits->infinite) {
+        // No limit
+    } else if (limits->moveTime > 0) {
+        soft = hard = limits->moveTime;
+    } else if (limits->time[us] > 0) {
+        int movesToGo = limits->movesToGo > 0 ? limits->movesToGo : 30;
+        long long available = limits->time[us] - MOVE_OVERHEAD_MS;
+        if (available < 1) available = 1;
+
+        soft = available / movesToGo + limits->increment[us] * 3 / 4;
+        hard = soft * 3;
+        if (hard > available / 2) hard = available / 2;
+        if (soft > hard) soft = hard;
+        if (hard < 1) soft = hard = 1;
+    }
+
+    searcher->softTimeLimitMs = soft;
+    searcher->hardTimeLimitMs = hard;
+}
+
+// Staged move picking: the hash move, then captures by MVV-LVA, then the killers, then the
+// remaining quiets by history, then the captures that lose material. Each stage is only
+// generated when the previous one ran out, so a cutoff early on never pays for the quiets.
+enum {
+    STAGE_HASH_MOVE,
+    STAGE_INIT_CAPTURES,
+    STAGE_CAPTURES,
+    STAGE_KILLERS,
+    STAGE_INIT_QUIETS,
+    STAGE_QUIETS,
+    STAGE_BAD_CAPTURES,
+    STAGE_DONE
+};
+
+typedef struct {
+    SearchThread *thread;
+    int stage;
+    int capturesOnly;
+    Move hashMove;
+    Move killers[2];
+    int killerIndex;
+    MoveList list;
+    int scores[MAX_MOVES];
+    int index;
+    MoveList badCaptures;  // Put off until after the quiets, or dropped when capturesOnly
+    int badIndex;
+} MovePicker;
+
+static const int orderingValues[6] = { PAWN_VALUE, KNIGHT_VALUE, BISHOP_VALUE, ROOK_VALUE, QUEEN_VALUE, 0 };
+
+#define HISTORY_MAX (1 << 20)
+
+static int isQuietMove(const Position *pos, Move move) {
+    return MOVE_KIND(move) != MOVE_EN_PASSANT && MOVE_KIND(move) != MOVE_PROMOTION &&
+           !(pos->occupiedBitboard & BIT(MOVE_TO(move)));
+}
+
+static void initMovePicker(MovePicker *picker, SearchThread *thread, Move hashMove, int ply) {
+    picker->thread = thread;
+    picker->stage = STAGE_HASH_MOVE;
+    picker->capturesOnly = 0;
+    picker->hashMove = isPseudoLegalMove(&thread->pos, hashMove) ? hashMove : NO_MOVE;
+    picker->killers[0] = thread->killerMoves[ply][0];
+    picker->killers[1] = thread->killerMoves[ply][1];
+    picker->killerIndex = 0;
+    picker->badCaptures.count = 0;
+    picker->badIndex = 0;
+}
+
+// Captures and promotions that do not lose material, for the quiescence search
+static void initCapturePicker(MovePicker *picker, SearchThread *thread) {
+    picker->thread = thread;
+    picker->stage = STAGE_INIT_CAPTURES;
+    picker->capturesOnly = 1;
+    picker->hashMove = NO_MOVE;
+    picker->badCaptures.count = 0;
+    picker->badIndex = 0;
+}
+
+// Taking a piece worth at least the capturer cannot lose; anything else is left to SEE
+static int isGoodCapture(const Position *pos, Move move) {
+    int from = MOVE_FROM(move), to = MOVE_TO(move);
+    char victim = pos->board[SQUARE_X(to)][SQUARE_Y(to)];
+
+    if (MOVE_KIND(move) == MOVE_NORMAL && victim != EMPTY &&
+        orderingValues[pieceType(victim)] >= orderingValues[pieceType(pos->board[SQUARE_X(from)][SQUARE_Y(from)])]) {
+        return 1;
+    }
+    return staticExchange(pos, move) >= 0;
+}
+
+// Most valuable victim first, and the least valuable attacker among equal victims
+static void scoreCaptures(MovePicker *picker) {
+    const Position *pos = &picker->thread->pos;
+    for (int i = 0; i < picker->list.count; i++) {
+        Move move = picker->list.moves[i];
+        int from = MOVE_FROM(move), to = MOVE_TO(move);
+        char victim = pos->board[SQUARE_X(to)][SQUARE_Y(to)];
+        int score = victim == EMPTY ? PAWN_VALUE : orderingValues[pieceType(victim)];
+
+        if (MOVE_KIND(move) == MOVE_PROMOTION) score += orderingValues[MOVE_PROMOTION_TYPE(move)];
+        picker->scores[i] = score * 8 - pieceType(pos->board[SQUARE_X(from)][SQUARE_Y(from)]);
+    }
+}
+
+static void scoreQuiets(MovePicker *picker) {
+    const SearchThread *thread = picker->thread;
+    int us = thread->pos.currentPlayer;
+    for (int i = 0; i < picker->list.count; i++) {
+        Move move = picker->list.moves[i];
+        picker->scores[i] = thread->historyTable[us][MOVE_FROM(move)][MOVE_TO(move)];
+    }
+}
+
+// Selection sort, one step at a time: most nodes only ever look at the first few moves
+static Move pickBest(MovePicker *picker) {
+    int best = picker->index;
+    for (int i = best + 1; i < picker->list.count; i++) {
+        if (picker->scores[i] > picker->scores[best]) best = i;
+    }
+
+    Move move = picker->list.moves[best];
+    int score = picker->scores[best];
+    picker->list.moves[best] = picker->list.moves[picker->index];
+    picker->scores[best] = picker->scores[picker->index];
+    picker->list.moves[picker->index] = move;
+    picker->scores[picker->index] = score;
+    picker->index++;
+    return move;
+}
+
+// Returns the next pseudo-legal move, or NO_MOVE once every stage is exhausted
+static Move nextMove(MovePicker *picker) {
+    const Position *pos = &picker->thread->pos;
+    Move move;
+
+    switch (picker->stage) {
+        case STAGE_HASH_MOVE:
+            picker->stage = STAGE_INIT_CAPTURES;
+            if (picker->hashMove != NO_MOVE) return picker->hashMove;
+            /* fall through */
+
+        case STAGE_INIT_CAPTURES:
+            generateCaptures(pos, &picker->list);
+            scoreCaptures(picker);
+            picker->index = 0;
+            picker->stage = STAGE_CAPTURES;
+            /* fall through */
+
+        case STAGE_CAPTURES:
+            while (picker->index < picker->list.count) {
+                move = pickBest(picker);
+                if (move == picker->hashMove) continue;
+                if (isGoodCapture(pos, move)) return move;
+                picker->badCaptures.moves[picker->badCaptures.count++] = move;
+            }
+            if (picker->capturesOnly) {
+                picker->stage = STAGE_DONE;
+                return NO_MOVE;
+            }
+            picker->stage = STAGE_KILLERS;
+            /* fall through */
+
+        case STAGE_KILLERS:
+            while (picker->killerIndex < 2) {
+                move = picker->killers[picker->killerIndex++];
+                if (move != NO_MOVE && move != picker->hashMove &&
+                    isQuietMove(pos, move) && isPseudoLegalMove(pos, move)) {
+                    return move;
                 }
             }
+            picker->stage = STAGE_INIT_QUIETS;
+            /* fall through */
+
+        case STAGE_INIT_QUIETS:
+            generateQuiets(pos, &picker->list);
+            scoreQuiets(picker);
+            picker->index = 0;
+            picker->stage = STAGE_QUIETS;
+            /* fall through */
+
+        case STAGE_QUIETS:
+            while (picker->index < picker->list.count) {
+                move = pickBest(picker);
+                if (move != picker->hashMove && move != picker->killers[0] && move != picker->killers[1]) {
+                    return move;
+                }
+            }
+            picker->stage = STAGE_BAD_CAPTURES;
+            /* fall through */
+
+        case STAGE_BAD_CAPTURES:
+            if (picker->badIndex < picker->badCaptures.count) return picker->badCaptures.moves[picker->badIndex++];
+            picker->stage = STAGE_DONE;
+            /* fall through */
+
+        default:
+            return NO_MOVE;
+    }
+}
+
+// A quiet move refuted this node: remember it as a killer and reward it in the history table
+static void updateQuietHistory(SearchThread *thread, Move move, int depth, int ply) {
+    int *entry = &thread->historyTable[thread->pos.currentPlayer][MOVE_FROM(move)][MOVE_TO(move)];
+
+    if (thread->killerMoves[ply][0] != move) {
+        thread->killerMoves[ply][1] = thread->killerMoves[ply][0];
+        thread->killerMoves[ply][0] = move;
+    }
+
+    *entry += depth * depth;
+    if (*entry >= HISTORY_MAX) {
+        for (int color = 0; color < 2; color++) {
+            for (int from = 0; from < 64; from++) {
+                for (int to = 0; to < 64; to++) thread->historyTable[color][from][to] /= 2;
+            }
+        }
+    }
+}
+
+// Killers are specific to the last search, history only loses weight
+static void clearMoveOrdering(SearchThread *thread) {
+    memset(thread->killerMoves, 0, sizeof(thread->killerMoves));
+    for (int color = 0; color < 2; color++) {
+        for (int from = 0; from < 64; from++) {
+            for (int to = 0; to < 64; to++) thread->historyTable[color][from][to] /= 8;
+        }
+    }
+}
+
+// Captures until the position is quiet. In check every evasion is searched instead and there
+// is no standing pat, so mates at the horizon are seen. There is no depth limit: each capture
+// takes material off the board, which ends the line soon enough.
+int quiescence(SearchThread *thread, int alpha, int beta, int ply) {
+    Position *pos = &thread->pos;
+
+    countNode(thread);
+    SEARCH_STAT(thread->stats.qnodes++; thread->stats.plyNodes[ply]++);
+    if (thread->searcher->stop) return 0;
+
+    bool inCheck = isKingInCheck(pos, pos->currentPlayer);
+    int standPat = 0;
+
+    if (!inCheck || ply >= MAX_PLY - 1) {
+        // evaluatePosition() favours the uppercase side, negamax wants the side to move
+        standPat = evaluatePosition(pos, &thread->pawnTable);
+        if (pos->currentPlayer == 0) standPat = -standPat;
+        if (ply >= MAX_PLY - 1) return standPat;
+
+        if (standPat >= beta) return beta;
+        // Delta pruning: not even winning a queen would bring the score back to alpha. A pawn
+        // about to promote can also turn into a queen on the way.
+        int us = pos->currentPlayer;
+        int maxGain = QUEEN_VALUE;
+        if (pos->pieceBitboards[us][PAWN] & ROW_MASK(us == 0 ? 1 : 6)) maxGain += QUEEN_VALUE - PAWN_VALUE;
+        if (standPat + maxGain + DELTA_MARGIN < alpha) return alpha;
+        if (alpha < standPat) alpha = standPat;
+    }
+
+    MovePicker picker;
+    Move move;
+    int legalMoves = 0;
+    if (inCheck) initMovePicker(&picker, thread, NO_MOVE, ply);
+    else initCapturePicker(&picker, thread);
+
+    while ((move = nextMove(&picker)) != NO_MOVE) {
+        if (!isLegalMove(pos, move)) continue;
+        legalMoves++;
+
+        // Delta pruning per move: the piece taken plus a margin still falls short of alpha
+        if (!inCheck && MOVE_KIND(move) != MOVE_PROMOTION) {
+            char victim = pos->board[SQUARE_X(MOVE_TO(move))][SQUARE_Y(MOVE_TO(move))];
+            int gain = victim == EMPTY ? PAWN_VALUE : orderingValues[pieceType(victim)];
+            if (standPat + gain + DELTA_MARGIN <= alpha) continue;
         }
+
+        doMove(pos, move);
+        int score = -quiescence(thread, -beta, -alpha, ply + 1);
+        undoMove(pos);
+
+        if (thread->searcher->stop) return 0;
+        if (score >= beta) return beta;
+        if (score > alpha) alpha = score;
     }
+
+    if (inCheck && legalMoves == 0) return -INFINITY_SCORE + ply;
     return alpha;
 }
 
-int pvSearch(int depth, int alpha, int beta, int maximizing) {
-    if(depth <= 0) return quiescence(alpha, beta, 0);
+static int hasNonPawnMaterial(const Position *pos, int color) {
+    return (pos->pieceBitboards[color][KNIGHT] | pos->pieceBitboards[color][BISHOP] |
+            pos->pieceBitboards[color][ROOK] | pos->pieceBitboards[color][QUEEN]) != 0;
+}
+
+// Mate scores are stored relative to the node, so they stay correct wherever the position recurs
+static int scoreToTT(int score, int ply) {
+    if (score >= MATE_BOUND) return score + ply;
+    if (score <= -MATE_BOUND) return score - ply;
+    return score;
+}
+
+static int scoreFromTT(int score, int ply) {
+    if (score >= MATE_BOUND) return score - ply;
+    if (score <= -MATE_BOUND) return score + ply;
+    return score;
+}
+
+// The line from ply is move followed by the line its child found
+static void updatePV(SearchThread *thread, int ply, Move move) {
+    int childLength = ply + 1 < MAX_PLY ? thread->pvTableLength[ply + 1] : 0;
+
+    if(childLength > MAX_PLY - 1 - ply) childLength = MAX_PLY - 1 - ply;
+    thread->pvTable[ply][0] = move;
+    memcpy(&thread->pvTable[ply][1], thread->pvTable[ply + 1], childLength * sizeof(Move));
+    thread->pvTableLength[ply] = childLength + 1;
+}
+
+int pvSearch(SearchThread *thread, int depth, int alpha, int beta, int ply) {
+    Position *pos = &thread->pos;
+    TranspositionTable *table = &thread->searcher->table;
+
+    thread->pvTableLength[ply] = 0;
+    if(depth <= 0) return quiescence(thread, alpha, beta, ply);
+    
+    countNode(thread);
+    SEARCH_STAT(thread->stats.nodes++; thread->stats.plyNodes[ply]++);
+    if(thread->searcher->stop) return 0;
+    
+    // A repetition inside the search or of a game position is scored as the draw it can be forced into
+    if(ply > 0 && (repetitionCount(pos) > 0 || isFiftyMoveDraw(pos))) return 0;
+    if(ply >= MAX_PLY - 8) return quiescence(thread, alpha, beta, ply);
+
+    // Bitbase draws end the line. Wins do too, unless the root is already a bitbase ending
+    // and the search has to find the actual mate.
+    if(ply > 0 && popCount(pos->occupiedBitboard) <= BITBASE_MAX_PIECES) {
+        int result = probeBitbase(pos);
+        if(result == BITBASE_DRAW) return 0;
+        if(result != BITBASE_NONE && !thread->rootInBitbase) {
+            int eval = evaluatePosition(pos, &thread->pawnTable);
+            return pos->currentPlayer == 1 ? eval : -eval;
+        }
+    }
     
-    int oldAlpha = alpha;
     int score;
+    int oldAlpha = alpha;
+    int legalMoves = 0;
     bool foundPV = false;
+    Move hashMove = NO_MOVE;
+    Move bestMove = NO_MOVE;
+    TTData entry;
+    
+    SEARCH_STAT(thread->stats.ttProbes++);
+    if(ttProbe(table, pos->positionKey, &entry)) {
+        SEARCH_STAT(thread->stats.ttHits++);
+        hashMove = entry.move;
+        // Only null-window nodes take cutoffs, so PV nodes keep their full line
+        if(entry.depth >= depth && beta - alpha == 1) {
+            int ttScore = scoreFromTT(entry.score, ply);
+            if(entry.bound == BOUND_EXACT ||
+               (entry.bound == BOUND_LOWER && ttScore >= beta) ||
+               (entry.bound == BOUND_UPPER && ttScore <= alpha)) {
+                return ttScore;
+            }
+        }
+    }
     
-    for(int i = 0; i < SIZE; i++) {
-        for(int j = 0; j < SIZE; j++) {
-            char piece = board[i][j];
-            if(piece == EMPTY || 
-              (maximizing && !isupper(piece)) ||
-              (!maximizing && isupper(piece))) continue;
-            
-            for(int x = 0; x < SIZE; x++) {
-                for(int y = 0; y < SIZE; y++) {
-                    if(isValidMove(i, j, x, y)) {
-                        char tempDest = board[x][y];
-                        board[x][y] = board[i][j];
-                        board[i][j] = EMPTY;
-                        
-                        if(!foundPV) {
-                            score = -pvSearch(depth - 1, -beta, -alpha, !maximizing);
-                        } else {
-                            score = -pvSearch(depth - 1, -alpha - 1, -alpha, !maximizing);
-                            if(score > alpha && score < beta) {
-                                score = -pvSearch(depth - 1, -beta, -alpha, !maximizing);
-                            }
-                        }
-                        
-                        board[i][j] = board[x][y];
-                        board[x][y] = tempDest;
-                        
-                        if(score >= beta) return beta;
-                        if(score > alpha) {
-                            alpha = score;
-                            foundPV = true;
-                        }
-                    }
+    // Along the previous iteration's line its moves are tried first
+    bool onPV = thread->followPV;
+    thread->followPV = 0;
+    if(onPV && ply < thread->pvLength) hashMove = thread->pv[ply];
+
+    const SearchOptions *options = &thread->searcher->options;
+    bool pvNode = beta - alpha > 1;
+    bool inCheck = isKingInCheck(pos, pos->currentPlayer);
+
+    // Null move: if passing still leaves us at or above beta after a reduced search, a real
+    // move will too. Not when in check, nor right after another null move, nor with only
+    // pawns left, where having to move can be the losing part (zugzwang).
+    if(options->nullMove && !pvNode && !inCheck && ply > 0 && depth >= NULL_MOVE_MIN_DEPTH &&
+       pos->undoStack[pos->undoCount - 1].move != NO_MOVE && hasNonPawnMaterial(pos, pos->currentPlayer)) {
+        int eval = evaluatePosition(pos, &thread->pawnTable);
+        if(pos->currentPlayer == 0) eval = -eval;
+
+        if(eval >= beta) {
+            int reduction = NULL_MOVE_REDUCTION + depth / 6;
+            SEARCH_STAT(thread->stats.nullMoves++);
+            doNullMove(pos);
+            score = -pvSearch(thread, depth - 1 - reduction, -beta, -beta + 1, ply + 1);
+            undoNullMove(pos);
+
+            if(thread->searcher->stop) return 0;
+            if(score >= beta) {
+                SEARCH_STAT(thread->stats.nullMoveCutoffs++);
+                return beta;
+            }
+        }
+    }
+    
+    MovePicker picker;
+    Move move;
+    initMovePicker(&picker, thread, hashMove, ply);
+    
+    while((move = nextMove(&picker)) != NO_MOVE) {
+        if(!isLegalMove(pos, move)) continue;
+        legalMoves++;
+
+        bool quiet = isQuietMove(pos, move);
+        bool killer = move == thread->killerMoves[ply][0] || move == thread->killerMoves[ply][1];
+        bool fullDepth = true;
+        
+        doMove(pos, move);
+        thread->followPV = onPV && move == hashMove;
+
+        // Late quiet moves are searched shallower first, and again at full depth only if
+        // they beat alpha. Checks, killers and escapes from check are never reduced.
+        if(options->lateMoveReductions && depth >= LMR_MIN_DEPTH && legalMoves > LMR_FULL_DEPTH_MOVES &&
+           quiet && !killer && !inCheck && !isKingInCheck(pos, pos->currentPlayer)) {
+            int reduction = 1 + (legalMoves > 8) + (depth >= 6) - pvNode;
+            if(reduction > depth - 2) reduction = depth - 2;
+            if(reduction > 0) {
+                SEARCH_STAT(thread->stats.reductions++);
+                score = -pvSearch(thread, depth - 1 - reduction, -alpha - 1, -alpha, ply + 1);
+                fullDepth = score > alpha;
+                SEARCH_STAT(thread->stats.reSearches += fullDepth);
+            }
+        }
+        
+        if(fullDepth) {
+            if(!foundPV) {
+                score = -pvSearch(thread, depth - 1, -beta, -alpha, ply + 1);
+            } else {
+                score = -pvSearch(thread, depth - 1, -alpha - 1, -alpha, ply + 1);
+                if(score > alpha && score < beta) {
+                    score = -pvSearch(thread, depth - 1, -beta, -alpha, ply + 1);
                 }
             }
         }
+        
+        undoMove(pos);
+        thread->followPV = 0;
+        
+        if(thread->searcher->stop) return 0;
+        if(score >= beta) {
+            if(quiet) updateQuietHistory(thread, move, depth, ply);
+            SEARCH_STAT(thread->stats.betaCutoffs++; thread->stats.firstMoveCutoffs += legalMoves == 1; thread->stats.ttStores++);
+            ttStore(table, pos->positionKey, move, scoreToTT(beta, ply), depth, BOUND_LOWER);
+            return beta;
+        }
+        if(score > alpha) {
+            alpha = score;
+            bestMove = move;
+            foundPV = true;
+            updatePV(thread, ply, move);
+        }
     }
     
-    if(alpha == oldAlpha) {
-        if(isKingInCheck(currentPlayer)) {
-            return -INFINITY_SCORE + (MAX_DEPTH - depth);
+    if(legalMoves == 0) {
+        if(inCheck) {
+            return -INFINITY_SCORE + ply;
         }
         return 0;
     }
     
+    SEARCH_STAT(thread->stats.ttStores++);
+    ttStore(table, pos->positionKey, bestMove, scoreToTT(alpha, ply), depth,
+            alpha > oldAlpha ? BOUND_EXACT : BOUND_UPPER);
     return alpha;
 }
 
-int getAIMove(int *fromX, int *fromY, int *toX, int *toY) {
-    static int openingPhase = 1;
 
-    if (openingPhase) {
-        if (getOpeningMove(fromX, fromY, toX, toY)) {
-            if (isValidMove(*fromX, *fromY, *toX, *toY)) {
-                return 1;
-            } else {
-                openingPhase = 0;
-            }
-        } else {
-            openingPhase = 0;
+void initSearcher(Searcher *searcher) {
+    memset(searcher, 0, sizeof(*searcher));
+    searcher->hashMegabytes = DEFAULT_HASH_MB;
+    searcher->threadCount = 1;
+    searcher->options.nullMove = 1;
+    searcher->options.lateMoveReductions = 1;
+}
+
+void freeSearcher(Searcher *searcher) {
+    ttFree(&searcher->table);
+    for (int i = 0; i < MAX_SEARCH_THREADS; i++) {
+        if (!searcher->threads[i]) continue;
+        pawnTableFree(&searcher->threads[i]->pawnTable);
+        free(searcher->threads[i]);
+        searcher->threads[i] = NULL;
+    }
+}
+
+// Resizing also clears the table
+void setHashSize(Searcher *searcher, int megabytes) {
+    searcher->hashMegabytes = megabytes;
+    ttInit(&searcher->table, megabytes);
+}
+
+// Forget everything learnt from earlier searches, e.g. before a new game
+void clearSearchTables(Searcher *searcher) {
+    ttClear(&searcher->table);
+    for (int i = 0; i < MAX_SEARCH_THREADS; i++) {
+        SearchThread *thread = searcher->threads[i];
+        if (!thread) continue;
+        memset(thread->killerMoves, 0, sizeof(thread->killerMoves));
+        memset(thread->historyTable, 0, sizeof(thread->historyTable));
+        if (thread->pawnTable.entries) {
+            memset(thread->pawnTable.entries, 0, PAWN_TABLE_ENTRIES * sizeof(PawnEntry));
         }
     }
+}
+
+// data is handed back to the callback unchanged
+void setSearchInfoCallback(Searcher *searcher, SearchInfoCallback callback, void *data) {
+    searcher->infoCallback = callback;
+    searcher->infoData = data;
+}
 
-    int bestScore = -INFINITY_SCORE;
-    int originalPlayer = currentPlayer;
+// One iteration over the root moves within alpha..beta, best move of the previous iteration
+// first. Returns the best score, alpha or beta if it lies outside the window, or 0 with the stop
+// flag set if the iteration was abandoned. bestMove is only set by a move that beats alpha.
+static int searchRoot(SearchThread *thread, MoveList *rootMoves, int depth, int alpha, int beta, Move *bestMove) {
+    Position *pos = &thread->pos;
+    volatile int *stop = &thread->searcher->stop;
+    int oldAlpha = alpha;
 
-    *fromX = -1;
-    *fromY = -1;
-    *toX = -1;
-    *toY = -1;
+    // The root is a node like any other, so ply 0 has its count too
+    countNode(thread);
+    SEARCH_STAT(thread->stats.nodes++; thread->stats.plyNodes[0]++);
 
-    for (int i = 0; i < SIZE; i++) {
-        for (int j = 0; j < SIZE; j++) {
-            char piece = board[i][j];
-            if (piece == EMPTY || 
-                (originalPlayer == 0 && isupper(piece)) ||
-                (originalPlayer == 1 && !isupper(piece))) {
-                continue;
+    thread->pvTableLength[0] = 0;
+    for (int i = 0; i < rootMoves->count; i++) {
+        Move move = rootMoves->moves[i];
+        int score;
+
+        doMove(pos, move);
+        if (i == 0) {
+            thread->followPV = thread->pvLength > 0 && move == thread->pv[0];
+            score = -pvSearch(thread, depth - 1, -beta, -alpha, 1);
+        } else {
+            score = -pvSearch(thread, depth - 1, -alpha - 1, -alpha, 1);
+            if (score > alpha && score < beta && !*stop) {
+                score = -pvSearch(thread, depth - 1, -beta, -alpha, 1);
             }
+        }
+        thread->followPV = 0;
+        undoMove(pos);
 
-            for (int x = 0; x < SIZE; x++) {
-                for (int y = 0; y < SIZE; y++) {
-                    if (isValidMove(i, j, x, y)) {
-                        char tempDest = board[x][y];
-                        board[x][y] = board[i][j];
-                        board[i][j] = EMPTY;
-
-                        int score = -pvSearch(MAX_DEPTH - 1, -INFINITY_SCORE, INFINITY_SCORE, false);
-
-                        board[i][j] = board[x][y];
-                        board[x][y] = tempDest;
-
-                        if (score > bestScore) {
-                            bestScore = score;
-                            *fromX = i;
-                            *fromY = j;
-                            *toX = x;
-                            *toY = y;
-                        }
-                    }
-                }
+        if (*stop) return 0;
+        if (score > alpha) {
+            *bestMove = move;
+            updatePV(thread, 0, move);
+            // Keep the best move at the front for the next iteration
+            for (int j = i; j > 0; j--) rootMoves->moves[j] = rootMoves->moves[j - 1];
+            rootMoves->moves[0] = move;
+            if (score >= beta) {
+                SEARCH_STAT(thread->stats.ttStores++);
+                ttStore(&thread->searcher->table, pos->positionKey, move, beta, depth, BOUND_LOWER);
+                return beta;
             }
+            alpha = score;
         }
     }
 
-    return (*fromX != -1);
+    if (alpha > oldAlpha) {
+        SEARCH_STAT(thread->stats.ttStores++);
+        ttStore(&thread->searcher->table, pos->positionKey, *bestMove, alpha, depth, BOUND_EXACT);
+    }
+    return alpha;
+}
+
+// Searches one depth with a window around the expected score, widening and searching again
+// until the score falls inside it. Mates, known wins and shallow depths get the full window.
+static int aspirationSearch(SearchThread *thread, MoveList *rootMoves, int depth, int expected, Move *bestMove) {
+    int window = ASPIRATION_WINDOW;
+    int alpha = -INFINITY_SCORE;
+    int beta = INFINITY_SCORE;
+
+    if (depth >= ASPIRATION_MIN_DEPTH && abs(expected) < KNOWN_WIN) {
+        alpha = expected - window;
+        beta = expected + window;
+    }
+
+    for (;;) {
+        Move move = rootMoves->moves[0];
+        int score = searchRoot(thread, rootMoves, depth, alpha, beta, &move);
+
+        if (thread->searcher->stop) return 0;
+        if (score <= alpha && alpha > -INFINITY_SCORE) {
+            alpha = score - window > -INFINITY_SCORE ? score - window : -INFINITY_SCORE;
+        } else if (score >= beta && beta < INFINITY_SCORE) {
+            beta = score + window < INFINITY_SCORE ? score + window : INFINITY_SCORE;
+        } else {
+            *bestMove = move;
+            return score;
+        }
+        window *= 2;
+    }
+}
+
+void initSearchLimits(SearchLimits *searchLimits) {
+    memset(searchLimits, 0, sizeof(*searchLimits));
+}
+
+void setSearchThreads(Searcher *searcher, int threads) {
+    if (threads < 1) threads = 1;
+    if (threads > MAX_SEARCH_THREADS) threads = MAX_SEARCH_THREADS;
+    searcher->threadCount = threads;
+}
+
+#ifdef SEARCH_STATS
+// Nodes and time of the iteration that just completed: whatever the earlier ones did not use
+static void recordIteration(SearchThread *thread, int depth, long long elapsed) {
+    SearchStats *stats = &thread->stats;
+    uint64_t nodes = getSearchNodes(thread->searcher);
+
+    for (int earlier = 1; earlier < depth; earlier++) {
+        nodes -= stats->iterationNodes[earlier];
+        elapsed -= stats->iterationMs[earlier];
+    }
+    stats->iterationNodes[depth] = nodes;
+    stats->iterationMs[depth] = elapsed;
+    stats->iterations = depth;
+}
+#endif
+
+// Helpers skip some depths, in a different pattern per thread, so that they spread over
+// neighbouring iterations instead of all repeating the main thread's
+static const int skipSize[16]  = { 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4 };
+static const int skipPhase[16] = { 0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3 };
+
+// Iterative deepening from depth 1 until a limit is reached. The move kept always comes from
+// the last iteration that completed. Only the main thread decides when the search is over.
+static void iterativeDeepening(SearchThread *thread) {
+    Searcher *searcher = thread->searcher;
+    MoveList rootMoves;
+
+    if (!thread->pawnTable.entries) pawnTableInit(&thread->pawnTable);
+    thread->bestMove = NO_MOVE;
+    thread->bestScore = 0;
+    thread->pvLength = 0;
+    clearMoveOrdering(thread);
+
+    generateLegalMoves(&thread->pos, &rootMoves);
+    if (rootMoves.count == 0) return;
+    thread->bestMove = rootMoves.moves[0];
+
+    int olderScore = 0;  // Of the iteration before the last
+    for (int depth = 1; depth <= searcher->maxDepth && !searcher->stop; depth++) {
+        if (thread->id > 0 && depth < searcher->maxDepth) {
+            int i = (thread->id - 1) % 16;
+            if (((depth + skipPhase[i]) / skipSize[i]) % 2) continue;
+        }
+
+        Move iterationMove = rootMoves.moves[0];
+        // Scores tend to swing between odd and even depths, so the window is centred between
+        // the last two
+        int score = aspirationSearch(thread, &rootMoves, depth, (thread->bestScore + olderScore) / 2, &iterationMove);
+        if (searcher->stop) break;
+
+        thread->bestMove = iterationMove;
+        olderScore = thread->bestScore;
+        thread->bestScore = score;
+        thread->pvLength = thread->pvTableLength[0];
+        memcpy(thread->pv, thread->pvTable[0], thread->pvLength * sizeof(Move));
+
+        if (thread->id > 0) continue;
+        long long elapsed = currentTimeMs() - searcher->startMs;
+        SEARCH_STAT(recordIteration(thread, depth, elapsed));
+        if (searcher->infoCallback) {
+            SearchInfo info;
+            info.depth = depth;
+            info.score = score;
+            info.nodes = getSearchNodes(searcher);
+            info.timeMs = elapsed;
+            info.pvLength = thread->pvLength < MAX_DEPTH ? thread->pvLength : MAX_DEPTH;
+            memcpy(info.pv, thread->pv, info.pvLength * sizeof(Move));
+            getSearchStats(searcher, &info.stats);
+            searcher->infoCallback(&info, searcher->infoData);
+        }
+        if (searcher->softTimeLimitMs && elapsed >= searcher->softTimeLimitMs) break;
+        // A forced mate that fits within this depth will not get any shorter
+        if (!searcher->limits.infinite && abs(score) >= MATE_BOUND && INFINITY_SCORE - abs(score) <= depth) break;
+    }
+}
+
+static void *helperThread(void *arg) {
+    iterativeDeepening(arg);
+    return NULL;
+}
+
+// Searches root with the searcher's threads and returns the main thread's move.
+// Returns 0 if there is no legal move, or if the thread contexts could not be allocated.
+int searchPosition(Searcher *searcher, const Position *root, const SearchLimits *searchLimits,
+                   Move *bestMove, int *bestScore) {
+    int threadCount = searcher->threadCount;
+    SearchThread *mainThread;
+
+    *bestMove = NO_MOVE;
+    *bestScore = 0;
+    for (int i = 0; i < threadCount; i++) {
+        if (!searcher->threads[i] && !(searcher->threads[i] = calloc(1, sizeof(SearchThread)))) return 0;
+    }
+
+    searcher->limits = *searchLimits;
+    searcher->maxDepth = searchLimits->depth > 0 && searchLimits->depth < MAX_DEPTH ? searchLimits->depth : MAX_DEPTH;
+    searcher->startMs = currentTimeMs();
+    searcher->stop = 0;
+    allocateTime(searcher, root->currentPlayer);
+
+    if (!searcher->table.entries) ttInit(&searcher->table, searcher->hashMegabytes);
+    ttNewSearch(&searcher->table);
+
+    // Every thread plays its lines out on its own copy of the root
+    for (int i = 0; i < threadCount; i++) {
+        SearchThread *thread = searcher->threads[i];
+        thread->searcher = searcher;
+        thread->id = i;
+        thread->nodes = 0;
+        memset(&thread->stats, 0, sizeof(thread->stats));
+        thread->pos = *root;
+        thread->rootInBitbase = probeBitbase(root) != BITBASE_NONE;
+    }
+    mainThread = searcher->threads[0];
+
+    // Helpers that cannot be started are done without; the search only needs the main thread
+    int helpers = 0;
+    while (helpers + 1 < threadCount &&
+           pthread_create(&searcher->threads[helpers + 1]->handle, NULL, helperThread, searcher->threads[helpers + 1]) == 0) {
+        helpers++;
+    }
+
+    iterativeDeepening(mainThread);
+
+    searcher->stop = 1;
+    for (int i = 1; i <= helpers; i++) {
+        pthread_join(searcher->threads[i]->handle, NULL);
+    }
+
+#ifdef SEARCH_STATS
+    if (searcher->statsOutput) {
+        SearchStats stats;
+        getSearchStats(searcher, &stats);
+        writeSearchStats(searcher->statsOutput, &stats);
+    }
+#endif
+
+    *bestMove = mainThread->bestMove;
+    *bestScore = mainThread->bestScore;
+    return *bestMove != NO_MOVE;
+}
+
+// Nodes of all threads together
+uint64_t getSearchNodes(const Searcher *searcher) {
+    uint64_t nodes = 0;
+    for (int i = 0; i < searcher->threadCount && searcher->threads[i]; i++) {
+        nodes += searcher->threads[i]->nodes;
+    }
+    return nodes;
+}
+
+void getSearchStats(const Searcher *searcher, SearchStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    for (int i = 0; i < searcher->threadCount && searcher->threads[i]; i++) {
+        const SearchStats *own = &searcher->threads[i]->stats;
+        stats->nodes += own->nodes;
+        stats->qnodes += own->qnodes;
+        for (int ply = 0; ply < MAX_PLY; ply++) stats->plyNodes[ply] += own->plyNodes[ply];
+        stats->betaCutoffs += own->betaCutoffs;
+        stats->firstMoveCutoffs += own->firstMoveCutoffs;
+        stats->ttProbes += own->ttProbes;
+        stats->ttHits += own->ttHits;
+        stats->ttStores += own->ttStores;
+        stats->nullMoves += own->nullMoves;
+        stats->nullMoveCutoffs += own->nullMoveCutoffs;
+        stats->reductions += own->reductions;
+        stats->reSearches += own->reSearches;
+    }
+    if (searcher->threads[0]) {
+        const SearchStats *main = &searcher->threads[0]->stats;
+        stats->iterations = main->iterations;
+        memcpy(stats->iterationNodes, main->iterationNodes, sizeof(stats->iterationNodes));
+        memcpy(stats->iterationMs, main->iterationMs, sizeof(stats->iterationMs));
+    }
+}
+
+// Growth of the tree per extra ply, averaged over the last two iterations to even out the
+// difference between odd and even depths. 0 until there are three iterations.
+double effectiveBranchingFactor(const SearchStats *stats) {
+    int last = stats->iterations;
+
+    if (last < 3 || stats->iterationNodes[last - 2] == 0) return 0;
+    return sqrt((double)stats->iterationNodes[last] / stats->iterationNodes[last - 2]);
+}
+
+static double rate(uint64_t part, uint64_t whole) {
+    return whole ? (double)part / whole : 0;
+}
+
+// One line of JSON, written with a single call so that searchers sharing output do not mix lines
+void writeSearchStats(FILE *output, const SearchStats *stats) {
+    char line[16384];
+    int length = 0;
+    int plies = MAX_PLY;
+
+#define APPEND(...) \
+    length += snprintf(line + length, length < (int)sizeof(line) ? sizeof(line) - length : 0, __VA_ARGS__)
+
+    APPEND("{\"nodes\":%llu,\"qnodes\":%llu,\"beta_cutoffs\":%llu,\"first_move_cutoff_rate\":%.3f,",
+           (unsigned long long)stats->nodes, (unsigned long long)stats->qnodes,
+           (unsigned long long)stats->betaCutoffs, rate(stats->firstMoveCutoffs, stats->betaCutoffs));
+    APPEND("\"tt_probes\":%llu,\"tt_hits\":%llu,\"tt_stores\":%llu,\"tt_hit_rate\":%.3f,",
+           (unsigned long long)stats->ttProbes, (unsigned long long)stats->ttHits,
+           (unsigned long long)stats->ttStores, rate(stats->ttHits, stats->ttProbes));
+    APPEND("\"null_moves\":%llu,\"null_move_cutoff_rate\":%.3f,\"reductions\":%llu,\"re_search_rate\":%.3f,",
+           (unsigned long long)stats->nullMoves, rate(stats->nullMoveCutoffs, stats->nullMoves),
+           (unsigned long long)stats->reductions, rate(stats->reSearches, stats->reductions));
+    APPEND("\"ebf\":%.2f,\"ply_nodes\":[", effectiveBranchingFactor(stats));
+    while (plies > 0 && stats->plyNodes[plies - 1] == 0) plies--;
+    for (int ply = 0; ply < plies; ply++) {
+        APPEND("%s%llu", ply ? "," : "", (unsigned long long)stats->plyNodes[ply]);
+    }
+    APPEND("],\"iterations\":[");
+    for (int depth = 1; depth <= stats->iterations; depth++) {
+        APPEND("%s{\"depth\":%d,\"nodes\":%llu,\"time_ms\":%lld}", depth > 1 ? "," : "", depth,
+               (unsigned long long)stats->iterationNodes[depth], stats->iterationMs[depth]);
+    }
+    APPEND("]}\n");
+#undef APPEND
+
+    if (length < (int)sizeof(line)) fputs(line, output);
+    fflush(output);
+}
+
+void setSearchStatsOutput(Searcher *searcher, FILE *output) {
+    searcher->statsOutput = output;
+}
+
+// A book move if the position is in the book, otherwise a search
+int getAIMove(GameState *game, Move *bestMove) {
+    *bestMove = probeBook(game->book, &game->position, (uint32_t)rand());
+    if (*bestMove != NO_MOVE) return 1;
+
+    SearchLimits gameLimits;
+    int score;
+
+    initSearchLimits(&gameLimits);
+    gameLimits.moveTime = AI_MOVE_TIME_MS;
+    return searchPosition(&game->searcher, &game->position, &gameLimits, bestMove, &score);
 }
@@ -0,0 +1,331 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <ctype.h>
+#include <pthread.h>
+#include <time.h>
+#include "batch.h"
+#include "board.h"
+#include "moves.h"
+
+#define BATCH_WINDOW 256          // Positions read ahead of the oldest one not yet written
+#define BATCH_LINE_SIZE 1024
+#define BATCH_OUTPUT_SIZE 2048
+#define BATCH_ID_SIZE 128
+
+enum { SLOT_FREE, SLOT_PENDING, SLOT_DONE };
+
+// One input line and, once analysed, its JSON line. Slots are reused round-robin, so at most
+// BATCH_WINDOW positions are in memory however long the input is.
+typedef struct {
+    int state;
+    char line[BATCH_LINE_SIZE];
+    char output[BATCH_OUTPUT_SIZE];
+} BatchSlot;
+
+// One analyseBatch() call: shared between the reader and the workers, guarded by lock
+typedef struct {
+    BatchSlot slots[BATCH_WINDOW];
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    long nextRead;   // Positions handed out by the reader so far
+    long nextTake;   // Next position a worker picks up
+    long nextWrite;  // Next position to be written, everything before it is out
+    int inputDone;
+    FILE *output;
+    const BatchOptions *options;
+} BatchPool;
+
+typedef struct {
+    pthread_t handle;
+    BatchPool *pool;
+    Searcher searcher;
+    SearchInfo lastInfo;  // Last iteration the searcher completed
+} BatchWorker;
+
+void initBatchOptions(BatchOptions *options) {
+    options->workers = 1;
+    options->hashMegabytes = BATCH_DEFAULT_HASH_MB;
+    initSearchLimits(&options->limits);
+    options->search.nullMove = 1;
+    options->search.lateMoveReductions = 1;
+    options->statsOutput = NULL;
+}
+
+static double elapsedSeconds(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void append(char *buffer, size_t *length, const char *format, ...) __attribute__((format(printf, 3, 4)));
+
+// Appends to a BATCH_OUTPUT_SIZE buffer, dropping whatever does not fit
+static void append(char *buffer, size_t *length, const char *format, ...) {
+    va_list args;
+
+    if (*length >= BATCH_OUTPUT_SIZE - 1) return;
+    va_start(args, format);
+    int written = vsnprintf(buffer + *length, BATCH_OUTPUT_SIZE - *length, format, args);
+    va_end(args);
+    if (written > 0) *length += written;
+    if (*length > BATCH_OUTPUT_SIZE - 1) *length = BATCH_OUTPUT_SIZE - 1;
+}
+
+static void appendJsonString(char *buffer, size_t *length, const char *text, size_t textLength) {
+    append(buffer, length, "\"");
+    for (size_t i = 0; i < textLength; i++) {
+        unsigned char c = text[i];
+        if (c == '"' || c == '\\') append(buffer, length, "\\%c", c);
+        else if (c < 0x20) append(buffer, length, "\\u%04x", c);
+        else append(buffer, length, "%c", c);
+    }
+    append(buffer, length, "\"");
+}
+
+// Skips one whitespace-separated field and the blanks after it
+static const char *skipField(const char *c) {
+    while (*c && !isspace((unsigned char)*c)) c++;
+    while (isspace((unsigned char)*c)) c++;
+    return c;
+}
+
+// EPD operations after the position: "id" names the position and "depth" (or "acd"), "nodes"
+// and "movetime" replace the default limits, e.g. "depth 10; id \"pos 7\";". Others are ignored.
+static void parseOperations(const char *c, SearchLimits *limits, char *id) {
+    while (*c) {
+        char opcode[16];
+        char operand[BATCH_ID_SIZE];
+        int length = 0;
+        int quoted = 0;
+
+        while (isspace((unsigned char)*c) || *c == ';') c++;
+        for (length = 0; *c && !isspace((unsigned char)*c) && *c != ';'; c++) {
+            if (length < (int)sizeof(opcode) - 1) opcode[length++] = *c;
+        }
+        opcode[length] = '\0';
+        while (isspace((unsigned char)*c)) c++;
+
+        // Strings are quoted and a backslash takes the next character as it is
+        for (length = 0; *c && (quoted || *c != ';'); c++) {
+            if (*c == '"') {
+                quoted = !quoted;
+                continue;
+            }
+            if (*c == '\\' && c[1]) c++;
+            if (length < (int)sizeof(operand) - 1) operand[length++] = *c;
+        }
+        while (length > 0 && isspace((unsigned char)operand[length - 1])) length--;
+        operand[length] = '\0';
+
+        if (strcmp(opcode, "id") == 0) strcpy(id, operand);
+        else if (strcmp(opcode, "depth") == 0 || strcmp(opcode, "acd") == 0) limits->depth = atoi(operand);
+        else if (strcmp(opcode, "nodes") == 0) limits->nodes = strtoull(operand, NULL, 10);
+        else if (strcmp(opcode, "movetime") == 0) limits->moveTime = atoi(operand);
+    }
+}
+
+static void reportIteration(const SearchInfo *info, void *data) {
+    ((BatchWorker *)data)->lastInfo = *info;
+}
+
+// Searches the position of one line and formats its result as one JSON object
+static void analyseLine(BatchWorker *worker, long index, const char *line, char *output) {
+    Position pos;
+    SearchLimits limits = worker->pool->options->limits;
+    char id[BATCH_ID_SIZE] = "";
+    size_t length = 0;
+
+    // Placement, side, castling and en passant, then the move counters of a FEN if present
+    const char *fenEnd = line;
+    for (int i = 0; i < 4; i++) fenEnd = skipField(fenEnd);
+    for (int i = 0; i < 2 && isdigit((unsigned char)*fenEnd); i++) fenEnd = skipField(fenEnd);
+    parseOperations(fenEnd, &limits, id);
+    while (fenEnd > line && isspace((unsigned char)fenEnd[-1])) fenEnd--;
+    if (!limits.depth && !limits.nodes && !limits.moveTime) limits.depth = BATCH_DEFAULT_DEPTH;
+    limits.stop = NULL;
+
+    append(output, &length, "{\"index\":%ld,", index);
+    if (id[0]) {
+        append(output, &length, "\"id\":");
+        appendJsonString(output, &length, id, strlen(id));
+        append(output, &length, ",");
+    }
+    append(output, &length, "\"fen\":");
+    appendJsonString(output, &length, line, fenEnd - line);
+
+    if (!setBoardFromFEN(&pos, line)) {
+        append(output, &length, ",\"error\":\"invalid position\"}\n");
+        return;
+    }
+
+    // Every position starts from empty tables, so the results do not depend on which worker
+    // analysed what before
+    struct timespec start;
+    Move bestMove;
+    int score;
+
+    clearSearchTables(&worker->searcher);
+    memset(&worker->lastInfo, 0, sizeof(worker->lastInfo));
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int found = searchPosition(&worker->searcher, &pos, &limits, &bestMove, &score);
+    long long timeMs = (long long)(elapsedSeconds(&start) * 1000);
+    uint64_t nodes = getSearchNodes(&worker->searcher);
+    const SearchInfo *info = &worker->lastInfo;
+
+    if (!found) {
+        // Checkmated or stalemated
+        append(output, &length, ",\"bestmove\":null,\"score\":{%s}",
+               isKingInCheck(&pos, pos.currentPlayer) ? "\"mate\":0" : "\"cp\":0");
+        append(output, &length, ",\"depth\":0,\"nodes\":0,\"time_ms\":%lld}\n", timeMs);
+        return;
+    }
+
+    char moveStr[6];
+    moveToString(bestMove, moveStr);
+    append(output, &length, ",\"bestmove\":\"%s\"", moveStr);
+
+    if (abs(score) >= MATE_BOUND) {
+        int moves = (INFINITY_SCORE - abs(score) + 1) / 2;
+        append(output, &length, ",\"score\":{\"mate\":%d}", score > 0 ? moves : -moves);
+    } else {
+        append(output, &length, ",\"score\":{\"cp\":%d}", score);
+    }
+
+    append(output, &length, ",\"depth\":%d,\"nodes\":%llu,\"time_ms\":%lld,\"pv\":[",
+           info->depth, (unsigned long long)nodes, timeMs);
+    for (int i = 0; i < info->pvLength; i++) {
+        moveToString(info->pv[i], moveStr);
+        append(output, &length, "%s\"%s\"", i ? "," : "", moveStr);
+    }
+    append(output, &length, "]}\n");
+}
+
+static void *workerLoop(void *arg) {
+    BatchWorker *worker = arg;
+    BatchPool *pool = worker->pool;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->nextTake == pool->nextRead && !pool->inputDone) pthread_cond_wait(&pool->changed, &pool->lock);
+        if (pool->nextTake == pool->nextRead) break;
+
+        long index = pool->nextTake++;
+        BatchSlot *slot = &pool->slots[index % BATCH_WINDOW];
+        pthread_mutex_unlock(&pool->lock);
+
+        slot->output[0] = '\0';
+        analyseLine(worker, index, slot->line, slot->output);
+
+        // Write out every finished position that is next in line
+        pthread_mutex_lock(&pool->lock);
+        slot->state = SLOT_DONE;
+        while (pool->nextWrite < pool->nextRead && pool->slots[pool->nextWrite % BATCH_WINDOW].state == SLOT_DONE) {
+            BatchSlot *done = &pool->slots[pool->nextWrite % BATCH_WINDOW];
+            fputs(done->output, pool->output);
+            done->state = SLOT_FREE;
+            pool->nextWrite++;
+        }
+        fflush(pool->output);
+        pthread_cond_broadcast(&pool->changed);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+// Hands every position line of input to the workers, waiting while the window is full
+static void readPositions(BatchPool *pool, FILE *input) {
+    char line[BATCH_LINE_SIZE];
+
+    while (fgets(line, sizeof(line), input)) {
+        size_t length = strcspn(line, "\r\n");
+
+        // Drop the rest of a line too long for the buffer
+        if (!line[length] && !feof(input)) {
+            int c;
+            while ((c = fgetc(input)) != EOF && c != '\n');
+        }
+        line[length] = '\0';
+
+        char *text = line;
+        while (isspace((unsigned char)*text)) text++;
+        if (!*text || *text == '#') continue;
+
+        pthread_mutex_lock(&pool->lock);
+        while (pool->nextRead - pool->nextWrite >= BATCH_WINDOW) pthread_cond_wait(&pool->changed, &pool->lock);
+        BatchSlot *slot = &pool->slots[pool->nextRead % BATCH_WINDOW];
+        strcpy(slot->line, text);
+        slot->state = SLOT_PENDING;
+        pool->nextRead++;
+        pthread_cond_broadcast(&pool->changed);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+long analyseBatch(FILE *input, FILE *output, const BatchOptions *options) {
+    int workerCount = options->workers > 0 ? options->workers : 1;
+    BatchWorker *workers = calloc(workerCount, sizeof(BatchWorker));
+    BatchPool *pool = calloc(1, sizeof(BatchPool));
+    struct timespec start;
+    int started = 0;
+
+    if (!workers || !pool) {
+        fprintf(stderr, "Could not allocate %d batch workers\n", workerCount);
+        free(workers);
+        free(pool);
+        return -1;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->changed, NULL);
+    pool->output = output;
+    pool->options = options;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // The pool shrinks to the workers that could be started
+    for (int i = 0; i < workerCount; i++) {
+        workers[i].pool = pool;
+        initSearcher(&workers[i].searcher);
+        setHashSize(&workers[i].searcher, options->hashMegabytes);
+        workers[i].searcher.options = options->search;
+        setSearchStatsOutput(&workers[i].searcher, options->statsOutput);
+        setSearchInfoCallback(&workers[i].searcher, reportIteration, &workers[i]);
+        if (pthread_create(&workers[i].handle, NULL, workerLoop, &workers[i]) != 0) {
+            freeSearcher(&workers[i].searcher);
+            break;
+        }
+        started++;
+    }
+
+    if (started == 0) {
+        fprintf(stderr, "Could not start any batch worker\n");
+    } else {
+        if (started < workerCount) fprintf(stderr, "Started only %d of %d batch workers\n", started, workerCount);
+        readPositions(pool, input);
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->inputDone = 1;
+    pthread_cond_broadcast(&pool->changed);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i].handle, NULL);
+        freeSearcher(&workers[i].searcher);
+    }
+    free(workers);
+
+    long positions = started ? pool->nextRead : -1;
+    pthread_cond_destroy(&pool->changed);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+
+    if (positions < 0) return -1;
+
+    double seconds = elapsedSeconds(&start);
+    fprintf(stderr, "Analysed %ld positions in %.3f s (%.1f positions/s)\n",
+            positions, seconds, seconds > 0 ? positions / seconds : 0.0);
+    return positions;
+}
@@ -0,0 +1,107 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <time.h>
+#include "bench.h"
+#include "board.h"
+#include "moves.h"
+#include "ai.h"
+
+// A spread of openings, middlegames, tactics and endgames. Changing the list changes the
+// signature, so add positions rather than edit them.
+static const char *benchPositions[] = {
+    // Openings and middlegames
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+    "rnbqkb1r/pp2pppp/3p1n2/8/3NP3/8/PPP2PPP/RNBQKB1R w KQkq - 1 5",
+    "rnbqkb1r/ppp1pppp/5n2/3p4/2PP4/8/PP2PPPP/RNBQKBNR w KQkq - 1 3",
+    "r1bq1rk1/ppp2ppp/2np1n2/2b1p3/2B1P3/2NP1N2/PPP2PPP/R1BQ1RK1 w - - 0 7",
+    "r2q1rk1/pp2bppp/2n1pn2/3p4/3P4/2NBPN2/PP3PPP/R2Q1RK1 w - - 0 10",
+    "rnbqk2r/ppp1bppp/4pn2/3p4/2PP4/2N2N2/PP2PPPP/R1BQKB1R w KQkq - 4 5",
+
+    // Tactics
+    "r1bqk2r/pp2bppp/2p5/3pP3/P2Q1P2/2N1B3/1PP3PP/R4RK1 b kq - 0 1",
+    "2rr3k/pp3pp1/1nnqbN1p/3pN3/2pP4/2P3Q1/PPB4P/R4RK1 w - - 0 1",
+    "5rk1/1ppb3p/p1pb4/6q1/3P1p1r/2P1R2P/PP1BQ1P1/5RKN w - - 0 1",
+    "r1bq2rk/pp3pbp/2p1p1pQ/7P/3P4/2PB1N2/PP3PPR/2KR4 w - - 0 1",
+    "3q1rk1/p4pp1/2pb3p/3p4/6Pr/1PNQ4/P1PB1PP1/4RRK1 b - - 0 1",
+    "2br2k1/2q3rn/p2NppQ1/2p1P3/Pp5R/4P3/1P3PPP/3R2K1 w - - 0 1",
+    "r4q1k/p2bR1rp/2p2Q1N/5p2/5p2/2P5/PP3PPP/R5K1 w - - 0 1",
+    "3r1rk1/p5pp/bpp1pp2/8/q1PP1P2/b3P3/P2NQRPP/1R2B1K1 b - - 0 1",
+    "r1b1k2r/ppppnppp/2n2q2/2b5/3NP3/2P1B3/PP3PPP/RN1QKB1R w KQkq - 0 1",
+    "r3r1k1/2p2ppp/p1p5/2b5/P3n3/1PN1B3/2P2PPP/R2R2K1 w - - 0 17",
+    "2kr3r/pp1q1ppp/5n2/1Nb5/2Pp1B2/7Q/P4PPP/1R3RK1 w - - 0 1",
+    "r1b2rk1/2q1b1pp/p2ppn2/1p6/3QP3/1BN1B3/PPP3PP/R4RK1 w - - 0 1",
+
+    // Endgames
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 11",
+    "6k1/pp3ppp/4p3/2P5/1P3P2/P3K1P1/7P/8 w - - 0 30",
+    "8/8/4kpp1/3p1b2/p6P/2B5/6P1/6K1 b - - 0 47",
+    "8/5pk1/6p1/3R4/6PP/5K2/r7/8 b - - 0 45",
+    "2r5/5pk1/6p1/3B4/7P/5PK1/4R3/8 w - - 0 50",
+    "8/8/3k4/3p4/3P1p2/5K2/8/8 w - - 0 1",
+    "8/3k4/8/3P4/3K4/8/8/3b4 w - - 0 60",
+    "r7/6k1/8/8/8/8/1R6/4K1B1 w - - 0 1",
+    "8/6pk/1p6/8/PP3p1p/5P2/4KP1q/3Q4 w - - 0 1",
+    "7k/3p2pp/4q3/8/4Q3/5Kp1/P6b/8 w - - 0 1",
+    "8/8/8/3k4/8/1R6/2P3K1/5r2 w - - 0 1",
+    "1r3k2/4q3/2Pp3b/3Bp3/2Q2p2/1p1P2P1/1P2KP2/3N4 w - - 0 1",
+    "6k1/4pp1p/3p2p1/P1pPb3/R7/1r2P1PP/3B1P2/6K1 w - - 0 1",
+    "5r1k/6pp/1n2Q3/4p3/8/7P/PP4PK/R1B1q3 b - - 0 1",
+    "r2qk2r/ppp1b1pp/2n1p3/3pP1n1/3P2b1/2PB1NN1/PP4PP/R1BQK2R w KQkq - 0 1",
+    "4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - - 7 19",
+    "rq3rk1/ppp2ppp/1bnpb3/3N2B1/3NP3/7P/PPPQ1PP1/2KR3R w - - 7 14",
+};
+
+#define BENCH_POSITIONS ((int)(sizeof(benchPositions) / sizeof(benchPositions[0])))
+
+static long long elapsedMs(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000LL + (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+int runBench(int depth, FILE *statsOutput) {
+    static Position pos;
+    Searcher searcher;
+    SearchLimits limits;
+    struct timespec start;
+    uint64_t totalNodes = 0;
+
+    initSearcher(&searcher);
+    setHashSize(&searcher, BENCH_HASH_MB);
+    setSearchStatsOutput(&searcher, statsOutput);
+    initSearchLimits(&limits);
+    limits.depth = depth;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < BENCH_POSITIONS; i++) {
+        Move bestMove;
+        int score;
+        char moveStr[6] = "0000";
+
+        if (!setBoardFromFEN(&pos, benchPositions[i])) {
+            fprintf(stderr, "Invalid bench position %d: %s\n", i + 1, benchPositions[i]);
+            freeSearcher(&searcher);
+            return 1;
+        }
+        clearSearchTables(&searcher);
+        if (searchPosition(&searcher, &pos, &limits, &bestMove, &score)) moveToString(bestMove, moveStr);
+
+        uint64_t nodes = getSearchNodes(&searcher);
+        totalNodes += nodes;
+        fprintf(stderr, "Position %2d/%d: %-5s %10llu nodes\n", i + 1, BENCH_POSITIONS, moveStr,
+                (unsigned long long)nodes);
+    }
+    long long ms = elapsedMs(&start);
+    freeSearcher(&searcher);
+
+    printf("Depth        : %d\n", depth);
+    printf("Total time ms: %lld\n", ms);
+    printf("Nodes        : %llu\n", (unsigned long long)totalNodes);
+    printf("Nodes/second : %llu\n", (unsigned long long)(ms > 0 ? totalNodes * 1000 / ms : totalNodes));
+    return 0;
+}
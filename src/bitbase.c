@@ -0,0 +1,357 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "bitbase.h"
+
+// Win/draw tables for a king and one or two pieces against a lone king. Each position is one
+// bit: set when the side with the pieces (the strong side) wins. In the tables the strong side
+// plays as color 0, so its pawns move towards row 0; positions with the strong side as color 1
+// are flipped vertically before the lookup.
+//
+// index = (((side * 64 + strongKing) * 64 + weakKing) * 64 + piece[0]) * 64 + piece[1]
+// where side is 0 with the strong side to move. Impossible positions are stored as draws.
+
+#define BITBASE_MAGIC 0x31424247u  // "GBB1"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t pieceCount;
+    uint64_t positions;
+} BitbaseHeader;
+
+typedef struct {
+    const char *name;
+    int pieceCount;
+    int pieces[2];          // Strong side pieces besides the king
+    uint64_t positions;
+    const uint8_t *bits;
+    void *mapping;          // Whole file, header included, or NULL if bits was allocated
+    size_t mappingSize;
+} Bitbase;
+
+// KPK comes after KQK and KRK: its promotions are looked up in them
+enum { KQK, KRK, KPK, KBNK, BITBASE_COUNT };
+
+static Bitbase bitbases[BITBASE_COUNT] = {
+    { "KQK",  1, { QUEEN, 0 },       0, NULL, NULL, 0 },
+    { "KRK",  1, { ROOK, 0 },        0, NULL, NULL, 0 },
+    { "KPK",  1, { PAWN, 0 },        0, NULL, NULL, 0 },
+    { "KBNK", 2, { BISHOP, KNIGHT }, 0, NULL, NULL, 0 },
+};
+
+// Generation states
+enum { UNKNOWN, ILLEGAL, DRAW, WIN_NEW, WIN_DONE };
+
+static inline int bitbaseBit(const Bitbase *bb, uint64_t index) {
+    return (bb->bits[index >> 3] >> (index & 7)) & 1;
+}
+
+static inline uint64_t encodeIndex(int pieceCount, int side, int strongKing, int weakKing, const int *squares) {
+    uint64_t index = ((uint64_t)side * 64 + strongKing) * 64 + weakKing;
+    for (int i = 0; i < pieceCount; i++) index = index * 64 + squares[i];
+    return index;
+}
+
+static inline void decodeIndex(int pieceCount, uint64_t index, int *side, int *strongKing, int *weakKing, int *squares) {
+    for (int i = pieceCount - 1; i >= 0; i--) {
+        squares[i] = index & 63;
+        index >>= 6;
+    }
+    *weakKing = index & 63;
+    *strongKing = (index >> 6) & 63;
+    *side = (int)(index >> 12);
+}
+
+static inline Bitboard pieceAttacks(int type, int sq, Bitboard occupied) {
+    switch (type) {
+        case PAWN:   return pawnAttacks[0][sq];
+        case KNIGHT: return knightAttacks[sq];
+        case BISHOP: return bishopAttacks(sq, occupied);
+        case ROOK:   return rookAttacks(sq, occupied);
+        case QUEEN:  return queenAttacks(sq, occupied);
+        default:     return kingAttacks[sq];
+    }
+}
+
+// Squares the strong side attacks, sliders looking through whatever is not in occupied
+static Bitboard strongAttacks(const Bitbase *bb, int strongKing, const int *squares, Bitboard occupied) {
+    Bitboard attacks = kingAttacks[strongKing];
+    for (int i = 0; i < bb->pieceCount; i++) attacks |= pieceAttacks(bb->pieces[i], squares[i], occupied);
+    return attacks;
+}
+
+// Classifies every position that is decided without looking further: illegal, mated,
+// stalemated, able to take a piece, or promoting into a won KQK or KRK. The weak side's
+// remaining moves are counted; a position it is to move in is lost once all of them are.
+static void classifyPositions(const Bitbase *bb, uint8_t *state, uint8_t *movesLeft) {
+    for (uint64_t index = 0; index < bb->positions; index++) {
+        int side, strongKing, weakKing, squares[2];
+        decodeIndex(bb->pieceCount, index, &side, &strongKing, &weakKing, squares);
+
+        Bitboard pieces = 0;
+        int legal = strongKing != weakKing && !(kingAttacks[strongKing] & BIT(weakKing));
+        for (int i = 0; i < bb->pieceCount && legal; i++) {
+            Bitboard square = BIT(squares[i]);
+            if (square & (pieces | BIT(strongKing) | BIT(weakKing))) legal = 0;
+            if (bb->pieces[i] == PAWN && (square & (ROW_MASK(0) | ROW_MASK(7)))) legal = 0;
+            pieces |= square;
+        }
+        if (!legal) {
+            state[index] = ILLEGAL;
+            continue;
+        }
+
+        Bitboard occupied = pieces | BIT(strongKing) | BIT(weakKing);
+        Bitboard attacked = strongAttacks(bb, strongKing, squares, occupied ^ BIT(weakKing));
+
+        if (side == 0) {
+            // The weak king cannot be in check with the strong side to move
+            if (attacked & BIT(weakKing)) {
+                state[index] = ILLEGAL;
+                continue;
+            }
+            // A promotion that wins the resulting KQK or KRK
+            if (bb->pieces[0] == PAWN && SQUARE_X(squares[0]) == 1 && !(occupied & BIT(squares[0] - 8)) &&
+                bitbases[KQK].bits && bitbases[KRK].bits) {
+                int promoted = squares[0] - 8;
+                uint64_t after = encodeIndex(1, 1, strongKing, weakKing, &promoted);
+                if (bitbaseBit(&bitbases[KQK], after) || bitbaseBit(&bitbases[KRK], after)) {
+                    state[index] = WIN_NEW;
+                }
+            }
+            continue;
+        }
+
+        Bitboard targets = kingAttacks[weakKing] & ~attacked & ~BIT(strongKing);
+        if (targets & pieces) {
+            // Taking a piece leaves a king and at most a minor piece: a draw
+            state[index] = DRAW;
+        } else if (!(targets & ~occupied)) {
+            state[index] = (attacked & BIT(weakKing)) ? WIN_NEW : DRAW;
+        } else {
+            movesLeft[index] = (uint8_t)popCount(targets & ~occupied);
+        }
+    }
+}
+
+// Positions the strong side could have reached index from, by undoing a move of piece
+// (-1 for the king) to an empty square
+static void markStrongPredecessors(const Bitbase *bb, uint8_t *state, int strongKing, int weakKing,
+                                   const int *squares, Bitboard occupied, int piece) {
+    int moved[2] = { squares[0], squares[1] };
+    Bitboard origins;
+
+    if (piece < 0) {
+        origins = kingAttacks[strongKing] & ~occupied;
+    } else if (bb->pieces[piece] == PAWN) {
+        // Pawns move towards row 0, so they came from the row below
+        int sq = squares[piece];
+        origins = 0;
+        if (SQUARE_X(sq) < 6 && !(occupied & BIT(sq + 8))) {
+            origins |= BIT(sq + 8);
+            if (SQUARE_X(sq) == 4 && !(occupied & BIT(sq + 16))) origins |= BIT(sq + 16);
+        }
+    } else {
+        origins = pieceAttacks(bb->pieces[piece], squares[piece], occupied) & ~occupied;
+    }
+
+    while (origins) {
+        int from = popLsb(&origins);
+        uint64_t previous;
+        if (piece < 0) {
+            previous = encodeIndex(bb->pieceCount, 0, from, weakKing, squares);
+        } else {
+            moved[piece] = from;
+            previous = encodeIndex(bb->pieceCount, 0, strongKing, weakKing, moved);
+            moved[piece] = squares[piece];
+        }
+        if (state[previous] == UNKNOWN) state[previous] = WIN_NEW;
+    }
+}
+
+// Retrograde analysis: every newly won position makes the positions before it won, at once
+// for the strong side and once the weak side has no other move left. Repeats until nothing
+// changes; whatever is still unknown then is a draw.
+static uint8_t *generateBitbase(const Bitbase *bb) {
+    uint8_t *state = calloc(bb->positions, 1);
+    uint8_t *movesLeft = calloc(bb->positions, 1);
+    uint8_t *bits = calloc(bb->positions / 8, 1);
+    int changed = 1;
+
+    if (!state || !movesLeft || !bits) {
+        free(state);
+        free(movesLeft);
+        free(bits);
+        return NULL;
+    }
+
+    classifyPositions(bb, state, movesLeft);
+
+    while (changed) {
+        changed = 0;
+        for (uint64_t index = 0; index < bb->positions; index++) {
+            if (state[index] != WIN_NEW) continue;
+            state[index] = WIN_DONE;
+            changed = 1;
+
+            int side, strongKing, weakKing, squares[2];
+            decodeIndex(bb->pieceCount, index, &side, &strongKing, &weakKing, squares);
+            Bitboard occupied = BIT(strongKing) | BIT(weakKing);
+            for (int i = 0; i < bb->pieceCount; i++) occupied |= BIT(squares[i]);
+
+            if (side == 1) {
+                markStrongPredecessors(bb, state, strongKing, weakKing, squares, occupied, -1);
+                for (int i = 0; i < bb->pieceCount; i++) {
+                    markStrongPredecessors(bb, state, strongKing, weakKing, squares, occupied, i);
+                }
+                continue;
+            }
+
+            // Every weak king move that leads here is one fewer way out
+            Bitboard origins = kingAttacks[weakKing] & ~occupied;
+            while (origins) {
+                uint64_t previous = encodeIndex(bb->pieceCount, 1, strongKing, popLsb(&origins), squares);
+                if (state[previous] == UNKNOWN && --movesLeft[previous] == 0) state[previous] = WIN_NEW;
+            }
+        }
+    }
+
+    for (uint64_t index = 0; index < bb->positions; index++) {
+        if (state[index] == WIN_DONE) bits[index >> 3] |= 1 << (index & 7);
+    }
+    free(state);
+    free(movesLeft);
+    return bits;
+}
+
+static int mapBitbase(Bitbase *bb, const char *path) {
+    struct stat info;
+    size_t expected = sizeof(BitbaseHeader) + bb->positions / 8;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0) return 0;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size != expected) {
+        close(fd);
+        return 0;
+    }
+    void *data = mmap(NULL, expected, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return 0;
+
+    const BitbaseHeader *header = data;
+    if (header->magic != BITBASE_MAGIC || header->pieceCount != (uint32_t)bb->pieceCount ||
+        header->positions != bb->positions) {
+        munmap(data, expected);
+        return 0;
+    }
+
+    bb->mapping = data;
+    bb->mappingSize = expected;
+    bb->bits = (const uint8_t *)data + sizeof(BitbaseHeader);
+    return 1;
+}
+
+// Written under a temporary name and renamed, so another engine that has the old file mapped
+// keeps a complete table
+static int saveBitbase(const Bitbase *bb, const uint8_t *bits, const char *path) {
+    BitbaseHeader header = { BITBASE_MAGIC, (uint32_t)bb->pieceCount, bb->positions };
+    char temporary[4096 + 8];
+    FILE *file;
+    int ok;
+
+    snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+    if (!(file = fopen(temporary, "wb"))) return 0;
+    ok = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(bits, bb->positions / 8, 1, file) == 1;
+    if (fclose(file) != 0) ok = 0;
+    if (ok && rename(temporary, path) != 0) ok = 0;
+    if (!ok) remove(temporary);
+    return ok;
+}
+
+int initBitbases(const char *dir, int generate) {
+    char missing[64] = "";
+    int available = 0;
+
+    freeBitbases();
+    if (generate) mkdir(dir, 0755);
+
+    for (int i = 0; i < BITBASE_COUNT; i++) {
+        Bitbase *bb = &bitbases[i];
+        char path[4096];
+
+        bb->positions = (uint64_t)2 << (6 * (2 + bb->pieceCount));
+        snprintf(path, sizeof(path), "%s/%s.bb", dir, bb->name);
+        if (!generate) {
+            if (mapBitbase(bb, path)) available++;
+            else snprintf(missing + strlen(missing), sizeof(missing) - strlen(missing), " %s", bb->name);
+            continue;
+        }
+
+        fprintf(stderr, "Generating the %s bitbase\n", bb->name);
+        uint8_t *bits = generateBitbase(bb);
+        if (!bits) {
+            fprintf(stderr, "Not enough memory for the %s bitbase\n", bb->name);
+            continue;
+        }
+
+        // Keep the generated copy if the file cannot be written and mapped back
+        if (saveBitbase(bb, bits, path) && mapBitbase(bb, path)) {
+            free(bits);
+        } else {
+            bb->bits = bits;
+        }
+        available++;
+    }
+
+    if (missing[0]) fprintf(stderr, "No%s bitbase in %s/, not probed; chess --bitbases builds them\n", missing, dir);
+    return available;
+}
+
+void freeBitbases(void) {
+    for (int i = 0; i < BITBASE_COUNT; i++) {
+        Bitbase *bb = &bitbases[i];
+        if (bb->mapping) munmap(bb->mapping, bb->mappingSize);
+        else free((void *)bb->bits);
+        bb->bits = NULL;
+        bb->mapping = NULL;
+    }
+}
+
+int probeBitbase(const Position *pos) {
+    int strong;
+
+    if (popCount(pos->occupiedBitboard) > BITBASE_MAX_PIECES) return BITBASE_NONE;
+    if (popCount(pos->colorBitboards[1]) == 1) strong = 0;
+    else if (popCount(pos->colorBitboards[0]) == 1) strong = 1;
+    else return BITBASE_NONE;
+
+    int pieceCount = popCount(pos->colorBitboards[strong]) - 1;
+    for (int i = 0; i < BITBASE_COUNT; i++) {
+        const Bitbase *bb = &bitbases[i];
+        if (bb->pieceCount != pieceCount || !bb->bits) continue;
+
+        int flip = strong == 0 ? 0 : 56;
+        int squares[2];
+        int matches = 1;
+        for (int j = 0; j < pieceCount && matches; j++) {
+            Bitboard piece = pos->pieceBitboards[strong][bb->pieces[j]];
+            if (popCount(piece) != 1) matches = 0;
+            else squares[j] = lsb(piece) ^ flip;
+        }
+        if (!matches) continue;
+
+        int side = pos->currentPlayer == strong ? 0 : 1;
+        uint64_t index = encodeIndex(pieceCount, side,
+                                     lsb(pos->pieceBitboards[strong][KING]) ^ flip,
+                                     lsb(pos->pieceBitboards[1 - strong][KING]) ^ flip, squares);
+        if (!bitbaseBit(bb, index)) return BITBASE_DRAW;
+        return side == 0 ? BITBASE_WIN : BITBASE_LOSS;
+    }
+    return BITBASE_NONE;
+}
@@ -0,0 +1,166 @@
+#include "bitboard.h"
+
+Bitboard knightAttacks[64];
+Bitboard kingAttacks[64];
+Bitboard pawnAttacks[2][64];
+Bitboard betweenSquares[64][64];
+Magic rookMagics[64];
+Magic bishopMagics[64];
+
+// Attack storage for every relevant occupancy of every square
+static Bitboard rookTable[0x19000];
+static Bitboard bishopTable[0x1480];
+
+static const int rookDirections[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+static const int bishopDirections[4][2] = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+
+static int onBoard(int x, int y) {
+    return x >= 0 && x < 8 && y >= 0 && y < 8;
+}
+
+// Attacks of a slider found by stepping along each ray, only used to fill the tables
+static Bitboard slidingAttacks(int sq, Bitboard occupied, const int directions[4][2]) {
+    Bitboard attacks = 0;
+    for (int d = 0; d < 4; d++) {
+        int x = SQUARE_X(sq) + directions[d][0];
+        int y = SQUARE_Y(sq) + directions[d][1];
+        while (onBoard(x, y)) {
+            attacks |= BIT(SQUARE(x, y));
+            if (occupied & BIT(SQUARE(x, y))) break;
+            x += directions[d][0];
+            y += directions[d][1];
+        }
+    }
+    return attacks;
+}
+
+// Squares whose occupancy matters: the rays without their last square
+static Bitboard relevantMask(int sq, const int directions[4][2]) {
+    Bitboard mask = 0;
+    for (int d = 0; d < 4; d++) {
+        int x = SQUARE_X(sq) + directions[d][0];
+        int y = SQUARE_Y(sq) + directions[d][1];
+        while (onBoard(x + directions[d][0], y + directions[d][1])) {
+            mask |= BIT(SQUARE(x, y));
+            x += directions[d][0];
+            y += directions[d][1];
+        }
+    }
+    return mask;
+}
+
+#ifndef USE_PEXT
+// xorshift64*, reseeded per square; the seeds (one per row) were picked to find magics quickly
+static const uint64_t magicSeeds[8] = { 728, 2985, 110, 2501, 1289, 2821, 1699, 255 };
+static uint64_t randomState;
+
+static uint64_t nextRandom(void) {
+    randomState ^= randomState >> 12;
+    randomState ^= randomState << 25;
+    randomState ^= randomState >> 27;
+    return randomState * 0x2545F4914F6CDD1DULL;
+}
+#endif
+
+static void initMagics(Magic *magics, Bitboard *table, const int directions[4][2]) {
+    static Bitboard occupancies[4096];
+    static Bitboard references[4096];
+#ifndef USE_PEXT
+    static int epoch[4096];
+    int attempt = 0;
+#endif
+    Bitboard *attacks = table;
+
+    for (int sq = 0; sq < 64; sq++) {
+        Magic *m = &magics[sq];
+        m->mask = relevantMask(sq, directions);
+        m->shift = 64 - popCount(m->mask);
+        m->attacks = attacks;
+
+        // Enumerate every subset of the mask (Carry-Rippler)
+        int size = 0;
+        Bitboard subset = 0;
+        do {
+            occupancies[size] = subset;
+            references[size] = slidingAttacks(sq, subset, directions);
+            size++;
+            subset = (subset - m->mask) & m->mask;
+        } while (subset);
+
+#ifdef USE_PEXT
+        m->magic = 0;
+        for (int i = 0; i < size; i++) {
+            m->attacks[magicIndex(m, occupancies[i])] = references[i];
+        }
+#else
+        // Try sparse random multipliers until one maps the subsets without destructive collisions
+        randomState = magicSeeds[SQUARE_X(sq)];
+        for (;;) {
+            m->magic = nextRandom() & nextRandom() & nextRandom();
+            if (popCount((m->mask * m->magic) >> 56) < 6) continue;
+
+            attempt++;
+            int i;
+            for (i = 0; i < size; i++) {
+                unsigned index = magicIndex(m, occupancies[i]);
+                if (epoch[index] < attempt) {
+                    epoch[index] = attempt;
+                    m->attacks[index] = references[i];
+                } else if (m->attacks[index] != references[i]) {
+                    break;
+                }
+            }
+            if (i == size) break;
+        }
+#endif
+        attacks += size;
+    }
+}
+
+void initBitboards(void) {
+    static const int knightSteps[8][2] = {
+        {2, 1}, {2, -1}, {-2, 1}, {-2, -1}, {1, 2}, {1, -2}, {-1, 2}, {-1, -2}
+    };
+    static int initialized = 0;
+
+    if (initialized) return;
+    initialized = 1;
+
+    for (int sq = 0; sq < 64; sq++) {
+        int x = SQUARE_X(sq);
+        int y = SQUARE_Y(sq);
+
+        for (int i = 0; i < 8; i++) {
+            if (onBoard(x + knightSteps[i][0], y + knightSteps[i][1])) {
+                knightAttacks[sq] |= BIT(SQUARE(x + knightSteps[i][0], y + knightSteps[i][1]));
+            }
+        }
+
+        for (int dx = -1; dx <= 1; dx++) {
+            for (int dy = -1; dy <= 1; dy++) {
+                if ((dx || dy) && onBoard(x + dx, y + dy)) {
+                    kingAttacks[sq] |= BIT(SQUARE(x + dx, y + dy));
+                }
+            }
+        }
+
+        for (int dy = -1; dy <= 1; dy += 2) {
+            if (onBoard(x - 1, y + dy)) pawnAttacks[0][sq] |= BIT(SQUARE(x - 1, y + dy));
+            if (onBoard(x + 1, y + dy)) pawnAttacks[1][sq] |= BIT(SQUARE(x + 1, y + dy));
+        }
+    }
+
+    initMagics(rookMagics, rookTable, rookDirections);
+    initMagics(bishopMagics, bishopTable, bishopDirections);
+
+    for (int from = 0; from < 64; from++) {
+        for (int to = 0; to < 64; to++) {
+            Bitboard blockers = BIT(from) | BIT(to);
+            if (rookAttacks(from, 0) & BIT(to)) {
+                betweenSquares[from][to] = rookAttacks(from, blockers) & rookAttacks(to, blockers);
+            } else if (bishopAttacks(from, 0) & BIT(to)) {
+                betweenSquares[from][to] = bishopAttacks(from, blockers) & bishopAttacks(to, blockers);
+            }
+        }
+    }
+}
@@ -1,17 +1,10 @@
 #include <stdio.h>
+#include <string.h>
 #include "board.h"
+#include "zobrist.h"
+#include "psqt.h"
 
-char board[SIZE][SIZE];
-int currentPlayer = 0;
-int canCastleKingside[2];
-int canCastleQueenside[2];
-int lastPawnDoubleMove[2];
-int lastMoveWasDoubleJump;
-int fiftyMoveCounter;
-int moveHistory[1000][4];
-int moveCount;
-
-void initializeBoard() {
+void initializeBoard(Position *pos) {
     char initialBoard[SIZE][SIZE] = {
         {'R', 'N', 'B', 'Q', 'K', 'B', 'N', 'R'},
         {'P', 'P', 'P', 'P', 'P', 'P', 'P', 'P'},
@@ -25,27 +18,145 @@ void initializeBoard() {
 
     for (int i = 0; i < SIZE; i++) {
         for (int j = 0; j < SIZE; j++) {
-            board[i][j] = initialBoard[i][j];
+            pos->board[i][j] = initialBoard[i][j];
         }
     }
     
     // Initialize castling rights
-    canCastleKingside[0] = canCastleKingside[1] = 1;
-    canCastleQueenside[0] = canCastleQueenside[1] = 1;
+    pos->canCastleKingside[0] = pos->canCastleKingside[1] = 1;
+    pos->canCastleQueenside[0] = pos->canCastleQueenside[1] = 1;
     
     // Initialize other variables
-    lastPawnDoubleMove[0] = lastPawnDoubleMove[1] = -1;
-    lastMoveWasDoubleJump = 0;
-    fiftyMoveCounter = 0;
-    moveCount = 0;
+    pos->currentPlayer = 0;
+    pos->lastPawnDoubleMove[0] = pos->lastPawnDoubleMove[1] = -1;
+    pos->lastMoveWasDoubleJump = 0;
+    pos->fiftyMoveCounter = 0;
+    pos->moveCount = 0;
+    pos->keyHistoryCount = 0;
+    pos->undoCount = 0;
+
+    syncBitboards(pos);
+    pos->positionKey = computePositionKey(pos);
+}
+
+// Every write to board[][] goes through here so the bitboards never go stale
+void setSquare(Position *pos, int x, int y, char piece) {
+    Bitboard bit = BIT(SQUARE(x, y));
+    char old = pos->board[x][y];
+    int sq = SQUARE(x, y);
+
+    if (old != EMPTY) {
+        int color = pieceColor(old), type = pieceType(old);
+        pos->pieceBitboards[color][type] ^= bit;
+        pos->colorBitboards[color] ^= bit;
+        pos->occupiedBitboard ^= bit;
+        pos->positionKey ^= pieceKeys[color][type][sq];
+        if (type == PAWN) pos->pawnKey ^= pieceKeys[color][PAWN][sq];
+        pos->pieceSquareScore[MIDGAME][color] -= pieceSquareValues[MIDGAME][color][type][sq];
+        pos->pieceSquareScore[ENDGAME][color] -= pieceSquareValues[ENDGAME][color][type][sq];
+    }
+    if (piece != EMPTY) {
+        int color = pieceColor(piece), type = pieceType(piece);
+        pos->pieceBitboards[color][type] ^= bit;
+        pos->colorBitboards[color] ^= bit;
+        pos->occupiedBitboard ^= bit;
+        pos->positionKey ^= pieceKeys[color][type][sq];
+        if (type == PAWN) pos->pawnKey ^= pieceKeys[color][PAWN][sq];
+        pos->pieceSquareScore[MIDGAME][color] += pieceSquareValues[MIDGAME][color][type][sq];
+        pos->pieceSquareScore[ENDGAME][color] += pieceSquareValues[ENDGAME][color][type][sq];
+    }
+    pos->board[x][y] = piece;
+}
+
+// Rebuild the bitboards from board[][] after it was filled directly
+void syncBitboards(Position *pos) {
+    for (int color = 0; color < 2; color++) {
+        pos->colorBitboards[color] = 0;
+        for (int type = PAWN; type <= KING; type++) {
+            pos->pieceBitboards[color][type] = 0;
+        }
+    }
+    pos->occupiedBitboard = 0;
+    pos->pawnKey = 0;
+    memset(pos->pieceSquareScore, 0, sizeof(pos->pieceSquareScore));
+
+    for (int i = 0; i < SIZE; i++) {
+        for (int j = 0; j < SIZE; j++) {
+            char piece = pos->board[i][j];
+            if (piece == EMPTY) continue;
+            int color = pieceColor(piece), type = pieceType(piece), sq = SQUARE(i, j);
+            pos->pieceBitboards[color][type] |= BIT(sq);
+            pos->colorBitboards[color] |= BIT(sq);
+            pos->occupiedBitboard |= BIT(sq);
+            if (type == PAWN) pos->pawnKey ^= pieceKeys[color][PAWN][sq];
+            pos->pieceSquareScore[MIDGAME][color] += pieceSquareValues[MIDGAME][color][type][sq];
+            pos->pieceSquareScore[ENDGAME][color] += pieceSquareValues[ENDGAME][color][type][sq];
+        }
+    }
+}
+
+// Set up a position from FEN. FEN writes White in uppercase, which is lowercase on this board.
+// Returns 0 (leaving the board unspecified) if the FEN is malformed.
+int setBoardFromFEN(Position *pos, const char *fen) {
+    char placement[90], side[2], castling[5], enPassant[3];
+    int halfmoves = 0, fullmoves = 1;
+
+    int fields = sscanf(fen, "%89s %1s %4s %2s %d %d", placement, side, castling, enPassant, &halfmoves, &fullmoves);
+    if (fields < 2) return 0;
+    if (fields < 3) strcpy(castling, "-");
+    if (fields < 4) strcpy(enPassant, "-");
+
+    int x = 0, y = 0;
+    for (const char *c = placement; *c; c++) {
+        if (*c == '/') {
+            if (y != SIZE) return 0;
+            x++;
+            y = 0;
+        } else if (*c >= '1' && *c <= '8') {
+            for (int n = *c - '0'; n > 0; n--) {
+                if (x >= SIZE || y >= SIZE) return 0;
+                pos->board[x][y++] = EMPTY;
+            }
+        } else if (strchr("pnbrqkPNBRQK", *c)) {
+            if (x >= SIZE || y >= SIZE) return 0;
+            pos->board[x][y++] = *c ^ 0x20;  // Swap case
+        } else {
+            return 0;
+        }
+    }
+    if (x != SIZE - 1 || y != SIZE) return 0;
+
+    syncBitboards(pos);
+    if (popCount(pos->pieceBitboards[0][KING]) != 1 || popCount(pos->pieceBitboards[1][KING]) != 1) return 0;
+    if ((pos->pieceBitboards[0][PAWN] | pos->pieceBitboards[1][PAWN]) & (ROW_MASK(0) | ROW_MASK(7))) return 0;
+
+    pos->currentPlayer = side[0] == 'b' ? 1 : 0;
+    pos->canCastleKingside[0] = strchr(castling, 'K') != NULL;
+    pos->canCastleQueenside[0] = strchr(castling, 'Q') != NULL;
+    pos->canCastleKingside[1] = strchr(castling, 'k') != NULL;
+    pos->canCastleQueenside[1] = strchr(castling, 'q') != NULL;
+
+    pos->lastPawnDoubleMove[0] = pos->lastPawnDoubleMove[1] = -1;
+    pos->lastMoveWasDoubleJump = 0;
+    if (enPassant[0] >= 'a' && enPassant[0] <= 'h') {
+        pos->lastMoveWasDoubleJump = 1;
+        pos->lastPawnDoubleMove[1 - pos->currentPlayer] = enPassant[0] - 'a';
+    }
+
+    pos->fiftyMoveCounter = halfmoves;
+    pos->moveCount = 2 * (fullmoves > 0 ? fullmoves - 1 : 0) + pos->currentPlayer;
+    pos->keyHistoryCount = 0;
+    pos->undoCount = 0;
+    pos->positionKey = computePositionKey(pos);
+    return 1;
 }
 
-void displayBoard() {
+void displayBoard(const Position *pos) {
     printf("\n  a b c d e f g h\n");
     for (int i = 0; i < SIZE; i++) {
         printf("%d ", 8 - i);
         for (int j = 0; j < SIZE; j++) {
-            printf("%c ", board[i][j]);
+            printf("%c ", pos->board[i][j]);
         }
         printf("%d\n", 8 - i);
     }
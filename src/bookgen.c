@@ -0,0 +1,553 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "board.h"
+#include "moves.h"
+#include "movegen.h"
+#include "zobrist.h"
+#include "psqt.h"
+#include "book.h"
+
+#define DEFAULT_MAX_PLY 24
+#define MAX_BOOK_PLY 1000               // Positions the key history of a Position has room for
+#define BATCH_TEXT_SIZE (1 << 20)       // PGN text handed to a worker at a time
+#define MAX_QUEUED_BATCHES(workers) (2 * (workers))
+#define COUNT_TABLE_INITIAL (1 << 16)
+
+// Times a move was played from a position and the points it scored: 2 for a win of the side
+// that played it, 1 for a draw or an unknown result, 0 for a loss
+typedef struct {
+    uint64_t key;
+    uint16_t move;
+    uint32_t count;
+    uint32_t points;
+} MoveCount;
+
+// Open addressing on (key, move); a zero count marks an empty slot
+typedef struct {
+    MoveCount *slots;
+    uint64_t mask;
+    uint64_t used;
+} CountTable;
+
+// Whole games of PGN text; starts[] holds the offset of each game
+typedef struct {
+    char *text;
+    size_t length;
+    size_t *starts;
+    int gameCount;
+    int startCapacity;
+} Batch;
+
+typedef struct {
+    pthread_t handle;
+    CountTable counts;
+    uint64_t games;
+    uint64_t positions;
+    uint64_t rejected;  // Games abandoned at a move that did not parse or was illegal
+} Worker;
+
+static int maxPly = DEFAULT_MAX_PLY;
+static int gamePerLine;  // Every line is a game of its own, as in openings.txt
+
+// Batches read but not yet taken by a worker
+static Batch **queue;
+static int queueCapacity, queueHead, queueCount;
+static int readingDone;
+static pthread_mutex_t queueLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queueChanged = PTHREAD_COND_INITIALIZER;
+
+static void *checkedMalloc(size_t size) {
+    void *p = malloc(size);
+    if (!p) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    return p;
+}
+
+static void initCountTable(CountTable *table) {
+    table->slots = calloc(COUNT_TABLE_INITIAL, sizeof(MoveCount));
+    if (!table->slots) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    table->mask = COUNT_TABLE_INITIAL - 1;
+    table->used = 0;
+}
+
+static MoveCount *findSlot(MoveCount *slots, uint64_t mask, uint64_t key, uint16_t move) {
+    uint64_t i = (key ^ (uint64_t)move * 0x9E3779B97F4A7C15ULL) & mask;
+    while (slots[i].count && (slots[i].key != key || slots[i].move != move)) i = (i + 1) & mask;
+    return &slots[i];
+}
+
+static void addCount(CountTable *table, uint64_t key, uint16_t move, uint32_t count, uint32_t points) {
+    // Kept at most half full
+    if (2 * (table->used + 1) > table->mask + 1) {
+        uint64_t newMask = 2 * table->mask + 1;
+        MoveCount *slots = calloc(newMask + 1, sizeof(MoveCount));
+        if (!slots) {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+        for (uint64_t i = 0; i <= table->mask; i++) {
+            if (table->slots[i].count) {
+                *findSlot(slots, newMask, table->slots[i].key, table->slots[i].move) = table->slots[i];
+            }
+        }
+        free(table->slots);
+        table->slots = slots;
+        table->mask = newMask;
+    }
+
+    MoveCount *slot = findSlot(table->slots, table->mask, key, move);
+    if (!slot->count) {
+        slot->key = key;
+        slot->move = move;
+        table->used++;
+    }
+    slot->count += count;
+    slot->points += points;
+}
+
+// Resolves a SAN move such as "Nbd7", "exd8=Q+" or "O-O", or a coordinate move such as "e2e4",
+// to the legal move it names. NO_MOVE if there is none or it is ambiguous.
+static Move parseSan(const Position *pos, const char *token) {
+    char san[16];
+    size_t length = strlen(token);
+    MoveList list;
+
+    if (length >= sizeof(san)) return NO_MOVE;
+    strcpy(san, token);
+    while (length > 0 && strchr("+#!?", san[length - 1])) san[--length] = '\0';
+    if (length < 2) return NO_MOVE;
+
+    int us = pos->currentPlayer;
+    int kingFrom = SQUARE(us == 0 ? 7 : 0, 4);
+    if (strcmp(san, "O-O") == 0 || strcmp(san, "0-0") == 0) return findLegalMove(pos, kingFrom, kingFrom + 2, QUEEN);
+    if (strcmp(san, "O-O-O") == 0 || strcmp(san, "0-0-0") == 0) return findLegalMove(pos, kingFrom, kingFrom - 2, QUEEN);
+
+    // Coordinate notation, as UCI and openings.txt write moves
+    if ((length == 4 || length == 5) && san[0] >= 'a' && san[0] <= 'h' && san[1] >= '1' && san[1] <= '8' &&
+        san[2] >= 'a' && san[2] <= 'h' && san[3] >= '1' && san[3] <= '8') {
+        int promotion = length == 5 ? pieceType(san[4]) : QUEEN;
+        return findLegalMove(pos, SQUARE('8' - san[1], san[0] - 'a'), SQUARE('8' - san[3], san[2] - 'a'), promotion);
+    }
+
+    int type = PAWN;
+    int promotion = -1;
+    const char *c = san;
+    if (strchr("NBRQK", *c)) type = pieceType(*c++);
+
+    if (length >= 2 && strchr("NBRQ", san[length - 1])) {
+        promotion = pieceType(san[length - 1]);
+        san[--length] = '\0';
+        if (length > 0 && san[length - 1] == '=') san[--length] = '\0';
+    }
+    if (length < 2) return NO_MOVE;
+
+    char toFile = san[length - 2], toRank = san[length - 1];
+    if (toFile < 'a' || toFile > 'h' || toRank < '1' || toRank > '8') return NO_MOVE;
+    int to = SQUARE('8' - toRank, toFile - 'a');
+
+    // Whatever stands between the piece letter and the destination narrows down the origin
+    int fromFile = -1, fromRow = -1;
+    for (; c < san + length - 2; c++) {
+        if (*c >= 'a' && *c <= 'h') fromFile = *c - 'a';
+        else if (*c >= '1' && *c <= '8') fromRow = '8' - *c;
+        else if (*c != 'x' && *c != '-') return NO_MOVE;
+    }
+
+    Move found = NO_MOVE;
+    generateLegalMoves(pos, &list);
+    for (int i = 0; i < list.count; i++) {
+        Move move = list.moves[i];
+        int from = MOVE_FROM(move);
+        if (MOVE_TO(move) != to || MOVE_KIND(move) == MOVE_CASTLING) continue;
+        if (pieceType(pos->board[SQUARE_X(from)][SQUARE_Y(from)]) != type) continue;
+        if (fromFile >= 0 && SQUARE_Y(from) != fromFile) continue;
+        if (fromRow >= 0 && SQUARE_X(from) != fromRow) continue;
+        if (MOVE_KIND(move) == MOVE_PROMOTION) {
+            if (MOVE_PROMOTION_TYPE(move) != (promotion >= 0 ? promotion : QUEEN)) continue;
+        } else if (promotion >= 0) {
+            continue;
+        }
+        if (found != NO_MOVE) return NO_MOVE;
+        found = move;
+    }
+    return found;
+}
+
+// 0 for a white win, 1 for a black win, 2 for a draw, -1 if the token is not a result
+static int parseResult(const char *token) {
+    if (strcmp(token, "1-0") == 0) return 0;
+    if (strcmp(token, "0-1") == 0) return 1;
+    if (strcmp(token, "1/2-1/2") == 0) return 2;
+    if (strcmp(token, "*") == 0) return 3;
+    return -1;
+}
+
+// Replays one game and counts the moves of its first maxPly plies
+static void addGame(Worker *worker, Position *pos, const char *text, const char *end) {
+    uint64_t keys[MAX_BOOK_PLY];
+    uint16_t moves[MAX_BOOK_PLY];
+    int movers[MAX_BOOK_PLY];
+    int plies = 0;
+    int result = 3;
+    int replaying = 1;
+    char fen[128] = "";
+
+    // Tag pairs first: only the result and a starting position matter
+    const char *c = text;
+    while (c < end) {
+        while (c < end && isspace((unsigned char)*c)) c++;
+        if (c >= end || *c != '[') break;
+
+        const char *lineEnd = memchr(c, '\n', end - c);
+        if (!lineEnd) lineEnd = end;
+        if (lineEnd - c > 10 && strncmp(c, "[Result \"", 9) == 0) {
+            char value[16];
+            size_t n = strcspn(c + 9, "\"");
+            if (n < sizeof(value)) {
+                memcpy(value, c + 9, n);
+                value[n] = '\0';
+                if (parseResult(value) >= 0) result = parseResult(value);
+            }
+        } else if (lineEnd - c > 7 && strncmp(c, "[FEN \"", 6) == 0) {
+            size_t n = strcspn(c + 6, "\"");
+            if (n < sizeof(fen)) {
+                memcpy(fen, c + 6, n);
+                fen[n] = '\0';
+            }
+        }
+        c = lineEnd;
+    }
+
+    if (!setBoardFromFEN(pos, fen[0] ? fen : START_FEN)) return;
+
+    // Movetext: comments, variations, move numbers and NAGs are skipped
+    int variationDepth = 0;
+    while (c < end) {
+        if (isspace((unsigned char)*c)) {
+            c++;
+        } else if (*c == '{') {
+            while (c < end && *c != '}') c++;
+            c++;
+        } else if (*c == ';' || *c == '%') {
+            while (c < end && *c != '\n') c++;
+        } else if (*c == '(') {
+            variationDepth++;
+            c++;
+        } else if (*c == ')') {
+            if (variationDepth > 0) variationDepth--;
+            c++;
+        } else {
+            char token[32];
+            int n = 0;
+            while (c < end && !isspace((unsigned char)*c) && !strchr("{}();", *c)) {
+                if (n < (int)sizeof(token) - 1) token[n++] = *c;
+                c++;
+            }
+            token[n] = '\0';
+            if (variationDepth > 0 || token[0] == '$') continue;
+
+            int tokenResult = parseResult(token);
+            if (tokenResult >= 0) {
+                result = tokenResult;
+                break;
+            }
+
+            // "12." or "12..." before the move, possibly without a space
+            char *move = token;
+            while (isdigit((unsigned char)*move)) move++;
+            if (*move == '.') {
+                while (*move == '.') move++;
+            } else {
+                move = token;
+            }
+            if (!*move || !replaying) continue;
+
+            Move parsed = parseSan(pos, move);
+            if (parsed == NO_MOVE) {
+                worker->rejected++;
+                replaying = 0;
+                continue;
+            }
+            keys[plies] = polyglotKey(pos);
+            moves[plies] = encodeBookMove(parsed);
+            movers[plies] = pos->currentPlayer;
+            plies++;
+            if (plies >= maxPly) {
+                replaying = 0;
+                continue;
+            }
+            playMove(pos, parsed);
+        }
+    }
+
+    for (int i = 0; i < plies; i++) {
+        uint32_t points = result == 2 || result == 3 ? 1 : result == movers[i] ? 2 : 0;
+        addCount(&worker->counts, keys[i], moves[i], 1, points);
+    }
+    worker->positions += plies;
+    if (plies > 0) worker->games++;
+}
+
+static void *workerLoop(void *arg) {
+    Worker *worker = arg;
+    Position *pos = checkedMalloc(sizeof(Position));
+
+    for (;;) {
+        pthread_mutex_lock(&queueLock);
+        while (queueCount == 0 && !readingDone) pthread_cond_wait(&queueChanged, &queueLock);
+        if (queueCount == 0) {
+            pthread_mutex_unlock(&queueLock);
+            break;
+        }
+        Batch *batch = queue[queueHead];
+        queueHead = (queueHead + 1) % queueCapacity;
+        queueCount--;
+        pthread_cond_broadcast(&queueChanged);
+        pthread_mutex_unlock(&queueLock);
+
+        for (int i = 0; i < batch->gameCount; i++) {
+            size_t gameEnd = i + 1 < batch->gameCount ? batch->starts[i + 1] : batch->length;
+            addGame(worker, pos, batch->text + batch->starts[i], batch->text + gameEnd);
+        }
+        free(batch->text);
+        free(batch->starts);
+        free(batch);
+    }
+
+    free(pos);
+    return NULL;
+}
+
+static Batch *newBatch(void) {
+    Batch *batch = checkedMalloc(sizeof(Batch));
+    batch->text = checkedMalloc(BATCH_TEXT_SIZE);
+    batch->length = 0;
+    batch->startCapacity = 1024;
+    batch->starts = checkedMalloc(batch->startCapacity * sizeof(size_t));
+    batch->gameCount = 0;
+    return batch;
+}
+
+static void queueBatch(Batch *batch) {
+    pthread_mutex_lock(&queueLock);
+    while (queueCount == queueCapacity) pthread_cond_wait(&queueChanged, &queueLock);
+    queue[(queueHead + queueCount) % queueCapacity] = batch;
+    queueCount++;
+    pthread_cond_broadcast(&queueChanged);
+    pthread_mutex_unlock(&queueLock);
+}
+
+// Splits the input into games line by line: a game starts at a tag line that follows
+// movetext, or at every line with -l. Full batches go to the workers.
+static void readGames(FILE *input, Batch **batch) {
+    char line[8192];
+    int inMovetext = 0;
+
+    while (fgets(line, sizeof(line), input)) {
+        size_t length = strlen(line);
+        int blank = strspn(line, " \t\r\n") == length;
+        int startsGame = gamePerLine ? !blank : line[0] == '[' && (inMovetext || (*batch)->gameCount == 0);
+
+        if (startsGame) {
+            // Start the game in a fresh batch if this one is full
+            if ((*batch)->length + sizeof(line) > BATCH_TEXT_SIZE) {
+                queueBatch(*batch);
+                *batch = newBatch();
+            }
+            if ((*batch)->gameCount == (*batch)->startCapacity) {
+                (*batch)->startCapacity *= 2;
+                (*batch)->starts = realloc((*batch)->starts, (*batch)->startCapacity * sizeof(size_t));
+                if (!(*batch)->starts) {
+                    fprintf(stderr, "Out of memory\n");
+                    exit(1);
+                }
+            }
+            (*batch)->starts[(*batch)->gameCount++] = (*batch)->length;
+            inMovetext = 0;
+        } else if (!blank && line[0] != '[') {
+            inMovetext = 1;
+            if ((*batch)->gameCount == 0) (*batch)->starts[(*batch)->gameCount++] = 0;
+        }
+
+        // A single game longer than a batch is cut short; it still counts up to there
+        if ((*batch)->length + length <= BATCH_TEXT_SIZE) {
+            memcpy((*batch)->text + (*batch)->length, line, length);
+            (*batch)->length += length;
+        }
+    }
+}
+
+static int compareCounts(const void *a, const void *b) {
+    const MoveCount *x = a, *y = b;
+    if (x->key != y->key) return x->key < y->key ? -1 : 1;
+    return (int)x->move - (int)y->move;
+}
+
+static double elapsedSeconds(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void usage(void) {
+    fprintf(stderr, "Usage: bookgen [-o book.bin] [-p maxPly] [-m minCount] [-t threads] [-l] [file.pgn ... | -]\n");
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    const char *outputPath = "book.bin";
+    int minCount = 1;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = cpus > 0 ? (int)cpus : 1;
+    int arg = 1;
+
+    for (; arg < argc && argv[arg][0] == '-' && argv[arg][1]; arg++) {
+        if (strcmp(argv[arg], "-o") == 0 && arg + 1 < argc) outputPath = argv[++arg];
+        else if (strcmp(argv[arg], "-p") == 0 && arg + 1 < argc) maxPly = atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-m") == 0 && arg + 1 < argc) minCount = atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-t") == 0 && arg + 1 < argc) threads = atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-l") == 0) gamePerLine = 1;
+        else usage();
+    }
+    if (maxPly < 1 || maxPly > MAX_BOOK_PLY) maxPly = maxPly < 1 ? 1 : MAX_BOOK_PLY;
+    if (threads < 1) threads = 1;
+
+    initBitboards();
+    initZobrist();
+    initPieceSquareTables();
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    Worker *workers = checkedMalloc(threads * sizeof(Worker));
+    queueCapacity = MAX_QUEUED_BATCHES(threads);
+    queue = checkedMalloc(queueCapacity * sizeof(Batch *));
+    // Carry on with the workers that could be started, if any
+    int started = 0;
+    for (int i = 0; i < threads; i++) {
+        memset(&workers[i], 0, sizeof(Worker));
+        initCountTable(&workers[i].counts);
+        if (pthread_create(&workers[i].handle, NULL, workerLoop, &workers[i]) != 0) {
+            free(workers[i].counts.slots);
+            break;
+        }
+        started++;
+    }
+    if (started == 0) {
+        fprintf(stderr, "Could not start any worker thread\n");
+        return 1;
+    }
+    if (started < threads) fprintf(stderr, "Started only %d of %d worker threads\n", started, threads);
+    threads = started;
+
+    Batch *batch = newBatch();
+    if (arg >= argc) {
+        readGames(stdin, &batch);
+    }
+    for (; arg < argc; arg++) {
+        FILE *input = strcmp(argv[arg], "-") == 0 ? stdin : fopen(argv[arg], "r");
+        if (!input) {
+            perror(argv[arg]);
+            continue;
+        }
+        readGames(input, &batch);
+        if (input != stdin) fclose(input);
+
+        // Games never continue from one file into the next
+        queueBatch(batch);
+        batch = newBatch();
+    }
+    queueBatch(batch);
+
+    pthread_mutex_lock(&queueLock);
+    readingDone = 1;
+    pthread_cond_broadcast(&queueChanged);
+    pthread_mutex_unlock(&queueLock);
+
+    // Every worker counted on its own; put the counts side by side and add up equal pairs
+    uint64_t total = 0, games = 0, positions = 0, rejected = 0;
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i].handle, NULL);
+        total += workers[i].counts.used;
+        games += workers[i].games;
+        positions += workers[i].positions;
+        rejected += workers[i].rejected;
+    }
+
+    MoveCount *all = checkedMalloc((total ? total : 1) * sizeof(MoveCount));
+    uint64_t count = 0;
+    for (int i = 0; i < threads; i++) {
+        for (uint64_t j = 0; j <= workers[i].counts.mask; j++) {
+            if (workers[i].counts.slots[j].count) all[count++] = workers[i].counts.slots[j];
+        }
+        free(workers[i].counts.slots);
+    }
+    qsort(all, count, sizeof(MoveCount), compareCounts);
+
+    uint64_t merged = 0;
+    uint32_t maxPoints = 1;
+    for (uint64_t i = 0; i < count; i++) {
+        if (merged > 0 && all[merged - 1].key == all[i].key && all[merged - 1].move == all[i].move) {
+            all[merged - 1].count += all[i].count;
+            all[merged - 1].points += all[i].points;
+        } else {
+            all[merged++] = all[i];
+        }
+    }
+    for (uint64_t i = 0; i < merged; i++) {
+        if (all[i].count >= (uint32_t)minCount && all[i].points > maxPoints) maxPoints = all[i].points;
+    }
+
+    // Weights are the points, scaled down to 16 bits if they do not fit. Moves that only ever
+    // lost keep weight 0 and are left out.
+    FILE *output = fopen(outputPath, "wb");
+    if (!output) {
+        perror(outputPath);
+        return 1;
+    }
+    uint64_t written = 0;
+    for (uint64_t i = 0; i < merged; i++) {
+        BookEntry entry;
+        unsigned char bytes[BOOK_ENTRY_SIZE];
+        uint64_t weight = all[i].points;
+
+        if (all[i].count < (uint32_t)minCount) continue;
+        if (maxPoints > 0xFFFF) weight = weight * 0xFFFF / maxPoints;
+        if (weight == 0) continue;
+
+        entry.key = all[i].key;
+        entry.move = all[i].move;
+        entry.weight = (uint16_t)weight;
+        entry.learn = 0;
+        writeBookEntry(bytes, &entry);
+        fwrite(bytes, BOOK_ENTRY_SIZE, 1, output);
+        written++;
+    }
+    if (fclose(output) != 0) {
+        perror(outputPath);
+        return 1;
+    }
+
+    double seconds = elapsedSeconds(&start);
+    printf("Games: %llu (%llu stopped at a bad move)\n", (unsigned long long)games, (unsigned long long)rejected);
+    printf("Positions: %llu\n", (unsigned long long)positions);
+    printf("Entries: %llu written to %s\n", (unsigned long long)written, outputPath);
+    printf("Time: %.3f s\n", seconds);
+
+    free(all);
+    free(workers);
+    free(queue);
+    return 0;
+}
@@ -6,23 +6,29 @@
 #include "board.h"
 #include "moves.h"
 #include "ai.h"
+#include "zobrist.h"
+#include "psqt.h"
+#include "uci.h"
+#include "batch.h"
+#include "bitbase.h"
+#include "bench.h"
 
 void clearInputBuffer() {
     int c;
     while ((c = getchar()) != '\n' && c != EOF);
 }
 
-void displayGameStatus() {
-    if (isKingInCheck(currentPlayer)) {
+void displayGameStatus(const Position *pos) {
+    if (isKingInCheck(pos, pos->currentPlayer)) {
         printf("CHECK!\n");
     }
     
-    printf("%s to move\n", currentPlayer == 0 ? "White" : "Black");
+    printf("%s to move\n", pos->currentPlayer == 0 ? "White" : "Black");
     
-    if (canCastleKingside[currentPlayer] || canCastleQueenside[currentPlayer]) {
+    if (pos->canCastleKingside[pos->currentPlayer] || pos->canCastleQueenside[pos->currentPlayer]) {
         printf("Castling available: %s%s\n",
-               canCastleKingside[currentPlayer] ? "O-O " : "",
-               canCastleQueenside[currentPlayer] ? "O-O-O" : "");
+               pos->canCastleKingside[pos->currentPlayer] ? "O-O " : "",
+               pos->canCastleQueenside[pos->currentPlayer] ? "O-O-O" : "");
     }
 }
 
@@ -59,24 +65,125 @@ void printMoveHistory(int moveNum, const char *move, int isAI) {
     printf("Move %d: %s %s\n", moveNum, isAI ? "AI plays" : "You play", move);
 }
 
-void formatMove(int fromX, int fromY, int toX, int toY, char *moveStr) {
-    sprintf(moveStr, "%c%d %c%d", 
-            'a' + fromY, 8 - fromX,
-            'a' + toY, 8 - toX);
+// stderr when "--stats -" was given, which is not ours to close
+static void closeStatsOutput(FILE *statsOutput) {
+    if (statsOutput && statsOutput != stderr) fclose(statsOutput);
 }
 
-int main() {
+void formatMove(int fromX, int fromY, int toX, int toY, char *moveStr, size_t size) {
+    snprintf(moveStr, size, "%c%d %c%d",
+             'a' + fromY, 8 - fromX,
+             'a' + toY, 8 - toX);
+}
+
+int main(int argc, char *argv[]) {
+    static GameState game;
+    static PolyglotBook openingBook;
+    const char *bookFile = "book.bin";
+    Position *pos = &game.position;
     char move[6];
     int gameActive = 1;
     int playerColor;
     int isPlayerTurn;
     int moveNumber = 1;
-    char formattedMove[6];
+    char formattedMove[32];  // Room for any int the format could be given
 
     srand(time(NULL));
 
-    initializeBoard();
-    loadOpenings(); // Load the openings
+    int uciMode = 0;
+    int buildBitbases = 0;
+    int benchDepth = 0;
+    int threads = 1;
+    const char *batchFile = NULL;
+    const char *statsFile = NULL;
+    FILE *statsOutput = NULL;
+    BatchOptions batch;
+    initBatchOptions(&batch);
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            bookFile = argv[++i];
+        } else if (strcmp(argv[i], "--uci") == 0) {
+            uciMode = 1;
+        } else if (strcmp(argv[i], "--bench") == 0) {
+            benchDepth = i + 1 < argc && isdigit((unsigned char)argv[i + 1][0]) ? atoi(argv[++i]) : BENCH_DEPTH;
+            if (benchDepth < 1) benchDepth = BENCH_DEPTH;
+        } else if (strcmp(argv[i], "--bitbases") == 0) {
+            buildBitbases = 1;
+        } else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc) {
+            statsFile = argv[++i];
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batchFile = argv[++i];
+        } else if (strcmp(argv[i], "-H") == 0 && i + 1 < argc) {
+            batch.hashMegabytes = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc) {
+            batch.limits.depth = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--nodes") == 0 && i + 1 < argc) {
+            batch.limits.nodes = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--movetime") == 0 && i + 1 < argc) {
+            batch.limits.moveTime = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--no-null-move") == 0) {
+            batch.search.nullMove = 0;
+        } else if (strcmp(argv[i], "--no-lmr") == 0) {
+            batch.search.lateMoveReductions = 0;
+        } else {
+            fprintf(stderr, "Usage: chess [-t threads] [-b book.bin] [--stats file|-] [--uci]\n"
+                            "       chess --bitbases\n"
+                            "       chess --bench [depth]\n"
+                            "       chess [-t workers] [-H hashMB] [--depth n] [--nodes n] [--movetime ms]\n"
+                            "             [--no-null-move] [--no-lmr] --batch file|-\n");
+            return 1;
+        }
+    }
+
+    initBitboards();
+    initZobrist();
+    initPieceSquareTables();
+    if (buildBitbases) return initBitbases(BITBASE_DIR, 1) ? 0 : 1;
+    initBitbases(BITBASE_DIR, 0);
+
+    // One JSON line of search statistics per search
+    if (statsFile) {
+#ifndef SEARCH_STATS
+        fprintf(stderr, "Search statistics are not compiled in; build with make STATS=1\n");
+        return 1;
+#endif
+        statsOutput = strcmp(statsFile, "-") == 0 ? stderr : fopen(statsFile, "a");
+        if (!statsOutput) {
+            perror(statsFile);
+            return 1;
+        }
+    }
+    if (benchDepth || uciMode) {
+        int status = benchDepth ? runBench(benchDepth, statsOutput) : uciLoop(threads, statsOutput);
+        closeStatsOutput(statsOutput);
+        return status;
+    }
+
+    if (batchFile) {
+        FILE *input = strcmp(batchFile, "-") == 0 ? stdin : fopen(batchFile, "r");
+        if (!input) {
+            perror(batchFile);
+            closeStatsOutput(statsOutput);
+            return 1;
+        }
+        batch.workers = threads;
+        batch.statsOutput = statsOutput;
+        if (batch.hashMegabytes < 1) batch.hashMegabytes = 1;
+        long analysed = analyseBatch(input, stdout, &batch);
+        if (input != stdin) fclose(input);
+        closeStatsOutput(statsOutput);
+        return analysed < 0 ? 1 : 0;
+    }
+
+    // Mapped, not read: opening even a huge book costs nothing up front
+    if (!openBook(&openingBook, bookFile)) {
+        printf("No opening book loaded from %s\n", bookFile);
+    }
+    initGame(&game, &openingBook);
+    setSearchThreads(&game.searcher, threads);
+    setSearchStatsOutput(&game.searcher, statsOutput);
     printf("\n=== Welcome to Chess with AI ===\n");
     printf("\nBoard notation:\n");
     printf("- Uppercase (RNBQKP) are Black pieces\n");
@@ -89,36 +196,36 @@ int main() {
     
     // Game loop
     while (gameActive) {
-        displayBoard();
-        displayGameStatus();
+        displayBoard(pos);
+        displayGameStatus(pos);
         
         // Check game ending conditions
-        if (isCheckmate(currentPlayer)) {
-            printf("\nCheckmate! %s wins!\n", currentPlayer == 0 ? "Black" : "White");
+        if (isCheckmate(pos, pos->currentPlayer)) {
+            printf("\nCheckmate! %s wins!\n", pos->currentPlayer == 0 ? "Black" : "White");
             break;
         }
         
-        if (isStalemate(currentPlayer)) {
+        if (isStalemate(pos, pos->currentPlayer)) {
             printf("\nStalemate! Game is drawn.\n");
             break;
         }
         
-        if (isThreefoldRepetition()) {
+        if (isThreefoldRepetition(pos)) {
             printf("\nDraw by threefold repetition!\n");
             break;
         }
         
-        if (isFiftyMoveDraw()) {
+        if (isFiftyMoveDraw(pos)) {
             printf("\nDraw by fifty-move rule!\n");
             break;
         }
         
-        if (hasInsufficientMaterial()) {
+        if (hasInsufficientMaterial(pos)) {
             printf("\nDraw by insufficient material!\n");
             break;
         }
         
-        isPlayerTurn = (currentPlayer == playerColor);
+        isPlayerTurn = (pos->currentPlayer == playerColor);
         
         if (isPlayerTurn) {
             // Player's turn
@@ -140,12 +247,11 @@ int main() {
                 int x1, y1, x2, y2;
                 convertNotation(move, &x1, &y1, &x2, &y2);
 
-                if (isValidMove(x1, y1, x2, y2)) {
+                if (isValidMove(pos, x1, y1, x2, y2)) {
                     printMoveHistory(moveNumber, move, 0);
-                    makeMove(x1, y1, x2, y2);
-                    recordMove(x1, y1, x2, y2);
-                    switchTurn();
-                    if (currentPlayer == 1) moveNumber++; // Increment after Black's move
+                    makeMove(pos, x1, y1, x2, y2);
+                    switchTurn(pos);
+                    if (pos->currentPlayer == 1) moveNumber++; // Increment after Black's move
                     break;
                 } else {
                     printf("Invalid move! Try again.\n");
@@ -154,14 +260,17 @@ int main() {
         } else {
             // GonAI's turn
             printf("\nGonAI is thinking...\n");
-            int fromX, fromY, toX, toY;
-            if (getAIMove(&fromX, &fromY, &toX, &toY)) {
-                formatMove(fromX, fromY, toX, toY, formattedMove);
+            Move aiMove;
+            if (getAIMove(&game, &aiMove)) {
+                int fromX = SQUARE_X(MOVE_FROM(aiMove)), fromY = SQUARE_Y(MOVE_FROM(aiMove));
+                int toX = SQUARE_X(MOVE_TO(aiMove)), toY = SQUARE_Y(MOVE_TO(aiMove));
+                char promotion = MOVE_KIND(aiMove) == MOVE_PROMOTION ?
+                                 pieceChar(pos->currentPlayer, MOVE_PROMOTION_TYPE(aiMove)) : 0;
+                formatMove(fromX, fromY, toX, toY, formattedMove, sizeof(formattedMove));
                 printMoveHistory(moveNumber, formattedMove, 1);
-                makeMove(fromX, fromY, toX, toY);
-                recordMove(fromX, fromY, toX, toY);
-                switchTurn();
-                if (currentPlayer == 1) moveNumber++; // Increment after Black's move
+                makeMoveWithPromotion(pos, fromX, fromY, toX, toY, promotion);
+                switchTurn(pos);
+                if (pos->currentPlayer == 1) moveNumber++; // Increment after Black's move
             } else {
                 printf("AI couldn't find a valid move!\n");
                 break;
@@ -173,8 +282,12 @@ int main() {
     }
 
     // Game end
-    displayBoard();
+    displayBoard(pos);
     printf("\n=== Game Over! ===\n");
 
+    freeGame(&game);
+    closeBook(&openingBook);
+    closeStatsOutput(statsOutput);
+
     return 0;
 }
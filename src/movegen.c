@@ -0,0 +1,85 @@
+#include "movegen.h"
+#include "board.h"
+
+static inline void addMove(MoveList *list, Move move) {
+    list->moves[list->count++] = move;
+}
+
+static void addPromotions(MoveList *list, int from, int to) {
+    for (int type = QUEEN; type >= KNIGHT; type--) {
+        addMove(list, ENCODE_PROMOTION(from, to, type));
+    }
+}
+
+#define CONCAT_(a, b) a##b
+#define CONCAT(a, b) CONCAT_(a, b)
+
+#define US 0
+#define COLOR_SUFFIX White
+#include "movegen_color.inc"
+#undef US
+#undef COLOR_SUFFIX
+
+#define US 1
+#define COLOR_SUFFIX Black
+#include "movegen_color.inc"
+#undef US
+#undef COLOR_SUFFIX
+
+// The side to move is looked at once per call, the generators themselves never branch on it
+void generateCaptures(const Position *pos, MoveList *list) {
+    if (pos->currentPlayer == 0) generateCapturesWhite(pos, list);
+    else generateCapturesBlack(pos, list);
+}
+
+void generateQuiets(const Position *pos, MoveList *list) {
+    if (pos->currentPlayer == 0) generateQuietsWhite(pos, list);
+    else generateQuietsBlack(pos, list);
+}
+
+void generateMoves(const Position *pos, MoveList *list) {
+    MoveList quiets;
+
+    generateCaptures(pos, list);
+    generateQuiets(pos, &quiets);
+    for (int i = 0; i < quiets.count; i++) {
+        addMove(list, quiets.moves[i]);
+    }
+}
+
+// Could the generators have produced this move here? Moves from the hash table or from
+// sibling nodes must pass this before they are played.
+int isPseudoLegalMove(const Position *pos, Move move) {
+    return pos->currentPlayer == 0 ? isPseudoLegalMoveWhite(pos, move) : isPseudoLegalMoveBlack(pos, move);
+}
+
+// Would the side to move be out of check after this pseudo-legal move?
+int isLegalMove(const Position *pos, Move move) {
+    return pos->currentPlayer == 0 ? isLegalMoveWhite(pos, move) : isLegalMoveBlack(pos, move);
+}
+
+void generateLegalMoves(const Position *pos, MoveList *list) {
+    generateMoves(pos, list);
+
+    int legal = 0;
+    for (int i = 0; i < list->count; i++) {
+        if (isLegalMove(pos, list->moves[i])) {
+            list->moves[legal++] = list->moves[i];
+        }
+    }
+    list->count = legal;
+}
+
+// promotionType only matters when from-to is a promotion
+Move findLegalMove(const Position *pos, int from, int to, int promotionType) {
+    MoveList list;
+    generateLegalMoves(pos, &list);
+
+    for (int i = 0; i < list.count; i++) {
+        Move move = list.moves[i];
+        if (MOVE_FROM(move) != from || MOVE_TO(move) != to) continue;
+        if (MOVE_KIND(move) == MOVE_PROMOTION && MOVE_PROMOTION_TYPE(move) != promotionType) continue;
+        return move;
+    }
+    return NO_MOVE;
+}
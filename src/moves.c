@@ -3,46 +3,35 @@
 #include <string.h>
 #include <ctype.h>
 #include "moves.h"
+#include "movegen.h"
 #include "board.h"
+#include "zobrist.h"
 
 // Helper function to check if path is clear between two squares
-int isPathClear(int x1, int y1, int x2, int y2) {
-    int dx = (x2 > x1) ? 1 : (x2 < x1) ? -1 : 0;
-    int dy = (y2 > y1) ? 1 : (y2 < y1) ? -1 : 0;
-    
-    int x = x1 + dx;
-    int y = y1 + dy;
-    
-    while (x != x2 || y != y2) {
-        if (board[x][y] != EMPTY) {
-            return 0;
-        }
-        x += dx;
-        y += dy;
-    }
-    return 1;
+int isPathClear(const Position *pos, int x1, int y1, int x2, int y2) {
+    return !(betweenSquares[SQUARE(x1, y1)][SQUARE(x2, y2)] & pos->occupiedBitboard);
 }
 
 // Individual piece move validation
-int isPawnMoveValid(int x1, int y1, int x2, int y2) {
-    int direction = (isupper(board[x1][y1])) ? 1 : -1;
+int isPawnMoveValid(const Position *pos, int x1, int y1, int x2, int y2) {
+    int direction = (isupper(pos->board[x1][y1])) ? 1 : -1;
     
     if (y1 == y2) {  // Moving forward
-        if (x2 == x1 + direction && board[x2][y2] == EMPTY) {
+        if (x2 == x1 + direction && pos->board[x2][y2] == EMPTY) {
             return 1;
         }
         // Initial double move
         if ((x1 == 1 && direction == 1) || (x1 == 6 && direction == -1)) {
             if (x2 == x1 + 2 * direction && 
-                board[x2][y2] == EMPTY && 
-                board[x1 + direction][y2] == EMPTY) {
+                pos->board[x2][y2] == EMPTY && 
+                pos->board[x1 + direction][y2] == EMPTY) {
                 return 1;
             }
         }
     } else if (abs(y2 - y1) == 1 && x2 == x1 + direction) {  // Capture or en passant
-        if (board[x2][y2] != EMPTY) {  // Regular capture
-            return (isupper(board[x1][y1]) != isupper(board[x2][y2]));
-        } else if (isEnPassantMove(x1, y1, x2, y2)) {  // En passant
+        if (pos->board[x2][y2] != EMPTY) {  // Regular capture
+            return (isupper(pos->board[x1][y1]) != isupper(pos->board[x2][y2]));
+        } else if (isEnPassantMove(pos, x1, y1, x2, y2)) {  // En passant
             return 1;
         }
     }
@@ -50,177 +39,135 @@ int isPawnMoveValid(int x1, int y1, int x2, int y2) {
 }
 
 int isKnightMoveValid(int x1, int y1, int x2, int y2) {
-    int dx = abs(x2 - x1);
-    int dy = abs(y2 - y1);
-    return (dx == 2 && dy == 1) || (dx == 1 && dy == 2);
+    return (knightAttacks[SQUARE(x1, y1)] & BIT(SQUARE(x2, y2))) != 0;
 }
 
-int isRookMoveValid(int x1, int y1, int x2, int y2) {
-    if (x1 != x2 && y1 != y2) return 0;
-    return isPathClear(x1, y1, x2, y2);
+int isRookMoveValid(const Position *pos, int x1, int y1, int x2, int y2) {
+    return (rookAttacks(SQUARE(x1, y1), pos->occupiedBitboard) & BIT(SQUARE(x2, y2))) != 0;
 }
 
-int isBishopMoveValid(int x1, int y1, int x2, int y2) {
-    if (abs(x2 - x1) != abs(y2 - y1)) return 0;
-    return isPathClear(x1, y1, x2, y2);
+int isBishopMoveValid(const Position *pos, int x1, int y1, int x2, int y2) {
+    return (bishopAttacks(SQUARE(x1, y1), pos->occupiedBitboard) & BIT(SQUARE(x2, y2))) != 0;
 }
 
-int isQueenMoveValid(int x1, int y1, int x2, int y2) {
-    if ((x1 != x2 && y1 != y2) && (abs(x2 - x1) != abs(y2 - y1))) return 0;
-    return isPathClear(x1, y1, x2, y2);
+int isQueenMoveValid(const Position *pos, int x1, int y1, int x2, int y2) {
+    return (queenAttacks(SQUARE(x1, y1), pos->occupiedBitboard) & BIT(SQUARE(x2, y2))) != 0;
 }
 
-int isKingMoveValid(int x1, int y1, int x2, int y2) {
-    if (isCastlingMove(x1, y1, x2, y2)) {
-        return canCastle(y2 > y1, currentPlayer);
+int isKingMoveValid(const Position *pos, int x1, int y1, int x2, int y2) {
+    if (isCastlingMove(pos, x1, y1, x2, y2)) {
+        return canCastle(pos, y2 > y1, pos->currentPlayer);
     }
     return abs(x2 - x1) <= 1 && abs(y2 - y1) <= 1;
 }
 
 // Game state checking functions
-void findKingPosition(int playerColor, int *kingX, int *kingY) {
-    char kingPiece = playerColor == 0 ? 'k' : 'K';
-    for (int i = 0; i < SIZE; i++) {
-        for (int j = 0; j < SIZE; j++) {
-            if (board[i][j] == kingPiece) {
-                *kingX = i;
-                *kingY = j;
-                return;
-            }
-        }
-    }
+void findKingPosition(const Position *pos, int playerColor, int *kingX, int *kingY) {
+    int sq = lsb(pos->pieceBitboards[playerColor][KING]);
+    *kingX = SQUARE_X(sq);
+    *kingY = SQUARE_Y(sq);
 }
 
-int isSquareUnderAttack(int x, int y, int attackingColor) {
-    for (int i = 0; i < SIZE; i++) {
-        for (int j = 0; j < SIZE; j++) {
-            char piece = board[i][j];
-            if (piece == EMPTY) continue;
-            
-            if ((attackingColor == 0 && !isupper(piece)) || 
-                (attackingColor == 1 && isupper(piece))) {
-                continue;
-            }
-
-            char pieceType = toupper(piece);
-            switch (pieceType) {
-                case 'P':
-                    if (isPawnMoveValid(i, j, x, y)) return 1;
-                    break;
-                case 'N':
-                    if (isKnightMoveValid(i, j, x, y)) return 1;
-                    break;
-                case 'R':
-                    if (isRookMoveValid(i, j, x, y)) return 1;
-                    break;
-                case 'B':
-                    if (isBishopMoveValid(i, j, x, y)) return 1;
-                    break;
-                case 'Q':
-                    if (isQueenMoveValid(i, j, x, y)) return 1;
-                    break;
-                case 'K':
-                    if (abs(x - i) <= 1 && abs(y - j) <= 1) return 1;
-                    break;
-            }
-        }
-    }
-    return 0;
+// Is (x, y) attacked by the opponent of defendingColor?
+int isSquareUnderAttack(const Position *pos, int x, int y, int defendingColor) {
+    return attackersTo(pos, SQUARE(x, y), pos->occupiedBitboard, 1 - defendingColor) != 0;
 }
 
-int isKingInCheck(int playerColor) {
+int isKingInCheck(const Position *pos, int playerColor) {
+    if (!pos->pieceBitboards[playerColor][KING]) return 0;
     int kingX, kingY;
-    findKingPosition(playerColor, &kingX, &kingY);
-    return isSquareUnderAttack(kingX, kingY, playerColor);
+    findKingPosition(pos, playerColor, &kingX, &kingY);
+    return isSquareUnderAttack(pos, kingX, kingY, playerColor);
 }
 
 // Special moves
-int isCastlingMove(int x1, int y1, int x2, int y2) {
-    char piece = board[x1][y1];
+int isCastlingMove(const Position *pos, int x1, int y1, int x2, int y2) {
+    char piece = pos->board[x1][y1];
     if (toupper(piece) != 'K') return 0;
     return abs(y2 - y1) == 2 && x1 == x2;
 }
 
-int canCastle(int kingside, int playerColor) {
+int canCastle(const Position *pos, int kingside, int playerColor) {
     int rank = playerColor == 0 ? 7 : 0;
     char king = playerColor == 0 ? 'k' : 'K';
     
     // Check if castling rights are still available
-    if (kingside && !canCastleKingside[playerColor]) return 0;
-    if (!kingside && !canCastleQueenside[playerColor]) return 0;
+    if (kingside && !pos->canCastleKingside[playerColor]) return 0;
+    if (!kingside && !pos->canCastleQueenside[playerColor]) return 0;
     
     // Check if king and rook are in correct positions
-    if (board[rank][4] != king) return 0;
-    if (kingside && board[rank][7] != (playerColor == 0 ? 'r' : 'R')) return 0;
-    if (!kingside && board[rank][0] != (playerColor == 0 ? 'r' : 'R')) return 0;
+    if (pos->board[rank][4] != king) return 0;
+    if (kingside && pos->board[rank][7] != (playerColor == 0 ? 'r' : 'R')) return 0;
+    if (!kingside && pos->board[rank][0] != (playerColor == 0 ? 'r' : 'R')) return 0;
     
     // Check if path is clear and not under attack
     int start = kingside ? 5 : 1;
     int end = kingside ? 6 : 3;
     for (int y = start; y <= end; y++) {
-        if (board[rank][y] != EMPTY) return 0;
-        if (isSquareUnderAttack(rank, y, playerColor)) return 0;
+        if (pos->board[rank][y] != EMPTY) return 0;
+        // The king never crosses the b-file, it only has to be empty
+        if (y != 1 && isSquareUnderAttack(pos, rank, y, playerColor)) return 0;
     }
     
     // Check if king is in check
-    if (isKingInCheck(playerColor)) return 0;
+    if (isKingInCheck(pos, playerColor)) return 0;
     
     return 1;
 }
 
-void performCastling(int x1, int y1, int x2, int y2) {
+void performCastling(Position *pos, int x1, int y1, int x2, int y2) {
     int isKingside = y2 > y1;
     int rank = x1;
     
     // Move king
-    board[x2][y2] = board[x1][y1];
-    board[x1][y1] = EMPTY;
+    setSquare(pos, x2, y2, pos->board[x1][y1]);
+    setSquare(pos, x1, y1, EMPTY);
     
     // Move rook
     if (isKingside) {
-        board[rank][5] = board[rank][7];
-        board[rank][7] = EMPTY;
+        setSquare(pos, rank, 5, pos->board[rank][7]);
+        setSquare(pos, rank, 7, EMPTY);
     } else {
-        board[rank][3] = board[rank][0];
-        board[rank][0] = EMPTY;
+        setSquare(pos, rank, 3, pos->board[rank][0]);
+        setSquare(pos, rank, 0, EMPTY);
     }
 }
 
-int isEnPassantMove(int x1, int y1, int x2, int y2) {
-    char piece = board[x1][y1];
+int isEnPassantMove(const Position *pos, int x1, int y1, int x2, int y2) {
+    char piece = pos->board[x1][y1];
     if (toupper(piece) != 'P') return 0;
     
     int direction = (isupper(piece)) ? 1 : -1;
     if (x2 != x1 + direction) return 0;
     
     // Check if it's a diagonal move to an empty square
-    if (abs(y2 - y1) != 1 || board[x2][y2] != EMPTY) return 0;
+    if (abs(y2 - y1) != 1 || pos->board[x2][y2] != EMPTY) return 0;
     
     // Check if there's an enemy pawn in the correct position that just moved
     char enemyPawn = (direction == 1) ? 'p' : 'P';
-    return board[x1][y2] == enemyPawn && 
-           lastMoveWasDoubleJump && 
-           lastPawnDoubleMove[1-currentPlayer] == y2;
+    return pos->board[x1][y2] == enemyPawn && 
+           pos->lastMoveWasDoubleJump && 
+           pos->lastPawnDoubleMove[1-pos->currentPlayer] == y2;
 }
 
-void performEnPassant(int x1, int y1, int x2, int y2) {
+void performEnPassant(Position *pos, int x1, int y1, int x2, int y2) {
     // Move the pawn
-    board[x2][y2] = board[x1][y1];
-    board[x1][y1] = EMPTY;
+    setSquare(pos, x2, y2, pos->board[x1][y1]);
+    setSquare(pos, x1, y1, EMPTY);
     
     // Remove the captured pawn
-    board[x1][y2] = EMPTY;
+    setSquare(pos, x1, y2, EMPTY);
 }
 
-int isPawnPromotion(int x1, int y1, int x2, int y2) {
+int isPawnPromotion(const Position *pos, int x1, int y1, int x2, int y2) {
     (void)y1;  
     (void)y2;
-    char piece = board[x1][y1];
+    char piece = pos->board[x1][y1];
     if (toupper(piece) != 'P') return 0;
     return (x2 == 0 && !isupper(piece)) || (x2 == 7 && isupper(piece));
 }
 
-void promotePawn(int x2, int y2) {
+void promotePawn(Position *pos, int x2, int y2) {
     char validPieces[] = "QRBN";
     char piece;
     
@@ -236,106 +183,124 @@ void promotePawn(int x2, int y2) {
     }
     
     // Convert to correct case based on player
-    if (currentPlayer == 0) {
+    if (pos->currentPlayer == 0) {
         piece = tolower(piece);
     }
     
-    board[x2][y2] = piece;
+    setSquare(pos, x2, y2, piece);
 }
 
 // Move validation and execution
-int isValidMove(int x1, int y1, int x2, int y2) {
+int isValidMove(Position *pos, int x1, int y1, int x2, int y2) {
     if (x1 < 0 || x1 >= SIZE || y1 < 0 || y1 >= SIZE ||
         x2 < 0 || x2 >= SIZE || y2 < 0 || y2 >= SIZE) {
         return 0;
     }
 
-    if (board[x1][y1] == EMPTY) return 0;
+    if (pos->board[x1][y1] == EMPTY) return 0;
 
     // Check if moving correct color piece
-    if (currentPlayer == 0 && isupper(board[x1][y1])) return 0;
-    if (currentPlayer == 1 && !isupper(board[x1][y1])) return 0;
+    if (pos->currentPlayer == 0 && isupper(pos->board[x1][y1])) return 0;
+    if (pos->currentPlayer == 1 && !isupper(pos->board[x1][y1])) return 0;
 
     // Check if capturing own piece
-    if (board[x2][y2] != EMPTY && 
-        (isupper(board[x1][y1]) == isupper(board[x2][y2]))) {
+    if (pos->board[x2][y2] != EMPTY && 
+        (isupper(pos->board[x1][y1]) == isupper(pos->board[x2][y2]))) {
         return 0;
     }
 
-    char piece = toupper(board[x1][y1]);
+    char piece = toupper(pos->board[x1][y1]);
     int moveValid = 0;
     
     switch (piece) {
-        case 'P': moveValid = isPawnMoveValid(x1, y1, x2, y2); break;
+        case 'P': moveValid = isPawnMoveValid(pos, x1, y1, x2, y2); break;
         case 'N': moveValid = isKnightMoveValid(x1, y1, x2, y2); break;
-        case 'R': moveValid = isRookMoveValid(x1, y1, x2, y2); break;
-        case 'B': moveValid = isBishopMoveValid(x1, y1, x2, y2); break;
-        case 'Q': moveValid = isQueenMoveValid(x1, y1, x2, y2); break;
-        case 'K': moveValid = isKingMoveValid(x1, y1, x2, y2); break;
+        case 'R': moveValid = isRookMoveValid(pos, x1, y1, x2, y2); break;
+        case 'B': moveValid = isBishopMoveValid(pos, x1, y1, x2, y2); break;
+        case 'Q': moveValid = isQueenMoveValid(pos, x1, y1, x2, y2); break;
+        case 'K': moveValid = isKingMoveValid(pos, x1, y1, x2, y2); break;
     }
     
     if (!moveValid) return 0;
 
     // Test if move would result in check
-    char tempDest = board[x2][y2];
-    char tempSrc = board[x1][y1];
-    board[x2][y2] = tempSrc;
-    board[x1][y1] = EMPTY;
+    char tempDest = pos->board[x2][y2];
+    char tempSrc = pos->board[x1][y1];
+    setSquare(pos, x2, y2, tempSrc);
+    setSquare(pos, x1, y1, EMPTY);
     
-    int inCheck = isKingInCheck(currentPlayer);
+    int inCheck = isKingInCheck(pos, pos->currentPlayer);
     
-    board[x1][y1] = tempSrc;
-    board[x2][y2] = tempDest;
+    setSquare(pos, x1, y1, tempSrc);
+    setSquare(pos, x2, y2, tempDest);
     
     return !inCheck;
 }
 
-void makeMove(int x1, int y1, int x2, int y2) {
+void makeMove(Position *pos, int x1, int y1, int x2, int y2) {
+    makeMoveWithPromotion(pos, x1, y1, x2, y2, 0);
+}
+
+// Only the keys since the last capture or pawn move can repeat, so a game move drops every
+// older one. However long the game, the search keeps MAX_PLY free entries for its own line.
+static void trimKeyHistory(Position *pos) {
+    int keep = pos->fiftyMoveCounter;
+    if (keep > KEY_HISTORY_SIZE - MAX_PLY) keep = KEY_HISTORY_SIZE - MAX_PLY;
+    if (pos->keyHistoryCount <= keep) return;
+
+    memmove(pos->keyHistory, pos->keyHistory + pos->keyHistoryCount - keep, keep * sizeof(pos->keyHistory[0]));
+    pos->keyHistoryCount = keep;
+}
+
+// promotion is the piece a pawn reaching the last rank becomes, or 0 to ask the player
+void makeMoveWithPromotion(Position *pos, int x1, int y1, int x2, int y2, char promotion) {
     // Update fifty move counter
-    if (toupper(board[x1][y1]) == 'P' || board[x2][y2] != EMPTY) {
-        fiftyMoveCounter = 0;
+    if (toupper(pos->board[x1][y1]) == 'P' || pos->board[x2][y2] != EMPTY) {
+        pos->fiftyMoveCounter = 0;
     } else {
-        fiftyMoveCounter++;
+        pos->fiftyMoveCounter++;
     }
     
-    // Store move in history
-    moveHistory[moveCount][0] = x1;
-    moveHistory[moveCount][1] = y1;
-    moveHistory[moveCount][2] = x2;
-    moveHistory[moveCount][3] = y2;
-    moveCount++;
+    // Store the position in the history
+    pos->keyHistory[pos->keyHistoryCount++] = pos->positionKey;
+    trimKeyHistory(pos);
+    pos->moveCount++;
     
     // Check for special moves BEFORE making the move
-    if (isCastlingMove(x1, y1, x2, y2)) {
-        performCastling(x1, y1, x2, y2);
-    } else if (isEnPassantMove(x1, y1, x2, y2)) {
-        performEnPassant(x1, y1, x2, y2);
-    } else if (isPawnPromotion(x1, y1, x2, y2)) {
+    if (isCastlingMove(pos, x1, y1, x2, y2)) {
+        performCastling(pos, x1, y1, x2, y2);
+    } else if (isEnPassantMove(pos, x1, y1, x2, y2)) {
+        performEnPassant(pos, x1, y1, x2, y2);
+    } else if (isPawnPromotion(pos, x1, y1, x2, y2)) {
         // First move the pawn
-        board[x2][y2] = board[x1][y1];
-        board[x1][y1] = EMPTY;
+        setSquare(pos, x2, y2, pos->board[x1][y1]);
+        setSquare(pos, x1, y1, EMPTY);
         // Then handle the promotion
-        promotePawn(x2, y2);
+        if (promotion) {
+            setSquare(pos, x2, y2, pieceChar(pos->currentPlayer, pieceType(promotion)));
+        } else {
+            promotePawn(pos, x2, y2);
+        }
     } else {
         // Regular move
-        board[x2][y2] = board[x1][y1];
-        board[x1][y1] = EMPTY;
+        setSquare(pos, x2, y2, pos->board[x1][y1]);
+        setSquare(pos, x1, y1, EMPTY);
     }
     
     // Update castling rights
-    if (toupper(board[x2][y2]) == 'K') {
-        canCastleKingside[currentPlayer] = 0;
-        canCastleQueenside[currentPlayer] = 0;
-    } else if (toupper(board[x2][y2]) == 'R') {
-        if (y1 == 0) canCastleQueenside[currentPlayer] = 0;
-        if (y1 == 7) canCastleKingside[currentPlayer] = 0;
+    if (toupper(pos->board[x2][y2]) == 'K') {
+        pos->canCastleKingside[pos->currentPlayer] = 0;
+        pos->canCastleQueenside[pos->currentPlayer] = 0;
+    } else if (toupper(pos->board[x2][y2]) == 'R') {
+        if (y1 == 0) pos->canCastleQueenside[pos->currentPlayer] = 0;
+        if (y1 == 7) pos->canCastleKingside[pos->currentPlayer] = 0;
     }
     
     // Update en passant information
-    lastMoveWasDoubleJump = 0;
-    if (toupper(board[x2][y2]) == 'P' && abs(x2 - x1) == 2) {
-        lastPawnDoubleMove[currentPlayer] = y2;
-        lastMoveWasDoubleJump = 1;
+    pos->lastMoveWasDoubleJump = 0;
+    if (toupper(pos->board[x2][y2]) == 'P' && abs(x2 - x1) == 2) {
+        pos->lastPawnDoubleMove[pos->currentPlayer] = y2;
+        pos->lastMoveWasDoubleJump = 1;
     }
 }
 
@@ -346,34 +311,46 @@ void convertNotation(const char *move, int *x1, int *y1, int *x2, int *y2) {
     *x2 = 8 - (move[4] - '0');
 }
 
-int isThreefoldRepetition() {
-    if (moveCount < 8) return 0;  // Need at least 8 moves for a repetition
-    
-    int repetitions = 1;  // Count current position
-    for (int i = 0; i < moveCount - 7; i += 2) {  // Check every full move
-        if (moveHistory[i][0] == moveHistory[moveCount-1][0] &&
-            moveHistory[i][1] == moveHistory[moveCount-1][1] &&
-            moveHistory[i][2] == moveHistory[moveCount-1][2] &&
-            moveHistory[i][3] == moveHistory[moveCount-1][3]) {
-            repetitions++;
-            if (repetitions >= 3) return 1;
-        }
+// Coordinate notation as used by UCI, e.g. "e2e4" or "e7e8q"
+void moveToString(Move move, char *str) {
+    int from = MOVE_FROM(move), to = MOVE_TO(move);
+
+    str[0] = 'a' + SQUARE_Y(from);
+    str[1] = '8' - SQUARE_X(from);
+    str[2] = 'a' + SQUARE_Y(to);
+    str[3] = '8' - SQUARE_X(to);
+    str[4] = MOVE_KIND(move) == MOVE_PROMOTION ? pieceChar(0, MOVE_PROMOTION_TYPE(move)) : '\0';
+    str[5] = '\0';
+}
+
+// How often the current position occurred before. Only positions with the same side to move
+// since the last capture or pawn move can repeat, so the scan stops fiftyMoveCounter plies back.
+int repetitionCount(const Position *pos) {
+    int count = 0;
+    int limit = pos->fiftyMoveCounter < pos->keyHistoryCount ? pos->fiftyMoveCounter : pos->keyHistoryCount;
+
+    for (int back = 4; back <= limit; back += 2) {
+        if (pos->keyHistory[pos->keyHistoryCount - back] == pos->positionKey) count++;
     }
-    return 0;
+    return count;
+}
+
+int isThreefoldRepetition(const Position *pos) {
+    return repetitionCount(pos) >= 2;
 }
 
-int isFiftyMoveDraw() {
-    return fiftyMoveCounter >= 100;  // 50 moves by each player = 100 half-moves
+int isFiftyMoveDraw(const Position *pos) {
+    return pos->fiftyMoveCounter >= 100;  // 50 moves by each player = 100 half-moves
 }
 
-int hasInsufficientMaterial() {
+int hasInsufficientMaterial(const Position *pos) {
     int pieces[2][6] = {0};  // [color][piece type]
     int totalPieces = 0;
     
     // Count all pieces
     for (int i = 0; i < SIZE; i++) {
         for (int j = 0; j < SIZE; j++) {
-            char piece = board[i][j];
+            char piece = pos->board[i][j];
             if (piece == EMPTY) continue;
             
             int color = isupper(piece) ? 1 : 0;
@@ -410,46 +387,192 @@ int hasInsufficientMaterial() {
     return 0;
 }
 
-int hasLegalMoves(int playerColor) {
-    for (int i = 0; i < SIZE; i++) {
-        for (int j = 0; j < SIZE; j++) {
-            char piece = board[i][j];
-            if (piece == EMPTY) continue;
-            
-            // Check if piece belongs to current player
-            if ((playerColor == 0 && isupper(piece)) || 
-                (playerColor == 1 && !isupper(piece))) {
-                continue;
-            }
-            
-            // Try all possible destinations
-            for (int x = 0; x < SIZE; x++) {
-                for (int y = 0; y < SIZE; y++) {
-                    if (isValidMove(i, j, x, y)) {
-                        return 1;  // Found at least one legal move
-                    }
-                }
-            }
-        }
+int hasLegalMoves(Position *pos, int playerColor) {
+    int savedPlayer = pos->currentPlayer;
+    int found = 0;
+    MoveList list;
+
+    pos->currentPlayer = playerColor;
+    generateMoves(pos, &list);
+    for (int i = 0; i < list.count && !found; i++) {
+        found = isLegalMove(pos, list.moves[i]);
     }
-    return 0;  // No legal moves found
+    pos->currentPlayer = savedPlayer;
+
+    return found;
 }
 
-int isCheckmate(int playerColor) {
-    if (!isKingInCheck(playerColor)) {
+int isCheckmate(Position *pos, int playerColor) {
+    if (!isKingInCheck(pos, playerColor)) {
         return 0;
     }
-    return !hasLegalMoves(playerColor);
+    return !hasLegalMoves(pos, playerColor);
 }
 
-int isStalemate(int playerColor) {
-    if (isKingInCheck(playerColor)) {
+int isStalemate(Position *pos, int playerColor) {
+    if (isKingInCheck(pos, playerColor)) {
         return 0;
     }
-    return !hasLegalMoves(playerColor);
+    return !hasLegalMoves(pos, playerColor);
 }
 
-void switchTurn() {
-    currentPlayer = 1 - currentPlayer;
+void switchTurn(Position *pos) {
+    pos->currentPlayer = 1 - pos->currentPlayer;
+    // makeMove() changes castling and en passant state without tracking the key
+    pos->positionKey = computePositionKey(pos);
 }
 
+// A move from or to a corner square removes the castling right of that rook
+static void updateCastlingRights(Position *pos, int sq) {
+    if (sq == SQUARE(7, 0)) pos->canCastleQueenside[0] = 0;
+    if (sq == SQUARE(7, 7)) pos->canCastleKingside[0] = 0;
+    if (sq == SQUARE(0, 0)) pos->canCastleQueenside[1] = 0;
+    if (sq == SQUARE(0, 7)) pos->canCastleKingside[1] = 0;
+}
+
+void doMove(Position *pos, Move move) {
+    UndoInfo *undo = &pos->undoStack[pos->undoCount++];
+    int us = pos->currentPlayer;
+    int from = MOVE_FROM(move), to = MOVE_TO(move);
+    int fromX = SQUARE_X(from), fromY = SQUARE_Y(from);
+    int toX = SQUARE_X(to), toY = SQUARE_Y(to);
+    char piece = pos->board[fromX][fromY];
+
+    undo->move = move;
+    undo->captured = pos->board[toX][toY];
+    for (int color = 0; color < 2; color++) {
+        undo->canCastleKingside[color] = pos->canCastleKingside[color];
+        undo->canCastleQueenside[color] = pos->canCastleQueenside[color];
+        undo->lastPawnDoubleMove[color] = pos->lastPawnDoubleMove[color];
+    }
+    undo->lastMoveWasDoubleJump = pos->lastMoveWasDoubleJump;
+    undo->fiftyMoveCounter = pos->fiftyMoveCounter;
+    undo->positionKey = pos->positionKey;
+    pos->keyHistory[pos->keyHistoryCount++] = pos->positionKey;
+
+    // setSquare() keeps the piece part of the key current; the rest is swapped at the end
+    pos->positionKey ^= castlingAndEnPassantKey(pos);
+
+    switch (MOVE_KIND(move)) {
+        case MOVE_CASTLING:
+            performCastling(pos, fromX, fromY, toX, toY);
+            break;
+        case MOVE_EN_PASSANT:
+            undo->captured = pos->board[fromX][toY];
+            performEnPassant(pos, fromX, fromY, toX, toY);
+            break;
+        case MOVE_PROMOTION:
+            setSquare(pos, toX, toY, pieceChar(us, MOVE_PROMOTION_TYPE(move)));
+            setSquare(pos, fromX, fromY, EMPTY);
+            break;
+        default:
+            setSquare(pos, toX, toY, piece);
+            setSquare(pos, fromX, fromY, EMPTY);
+            break;
+    }
+
+    int isPawn = pieceType(piece) == PAWN;
+    pos->fiftyMoveCounter = (isPawn || undo->captured != EMPTY) ? 0 : pos->fiftyMoveCounter + 1;
+
+    if (pieceType(piece) == KING) {
+        pos->canCastleKingside[us] = 0;
+        pos->canCastleQueenside[us] = 0;
+    }
+    updateCastlingRights(pos, from);
+    updateCastlingRights(pos, to);
+
+    pos->lastMoveWasDoubleJump = isPawn && abs(toX - fromX) == 2;
+    if (pos->lastMoveWasDoubleJump) {
+        pos->lastPawnDoubleMove[us] = toY;
+    }
+
+    pos->currentPlayer = 1 - us;
+    pos->moveCount++;
+    pos->positionKey ^= castlingAndEnPassantKey(pos) ^ sideKey;
+}
+
+// Passes the turn, for null-move pruning. Nothing moves, so only the en passant right, the
+// side to move and the key change. Repetitions are not looked for across a null move.
+void doNullMove(Position *pos) {
+    UndoInfo *undo = &pos->undoStack[pos->undoCount++];
+
+    undo->move = NO_MOVE;
+    undo->lastMoveWasDoubleJump = pos->lastMoveWasDoubleJump;
+    undo->fiftyMoveCounter = pos->fiftyMoveCounter;
+    undo->positionKey = pos->positionKey;
+    pos->keyHistory[pos->keyHistoryCount++] = pos->positionKey;
+
+    pos->positionKey ^= castlingAndEnPassantKey(pos);
+    pos->lastMoveWasDoubleJump = 0;
+    pos->fiftyMoveCounter = 0;
+    pos->currentPlayer = 1 - pos->currentPlayer;
+    pos->moveCount++;
+    pos->positionKey ^= castlingAndEnPassantKey(pos) ^ sideKey;
+}
+
+void undoNullMove(Position *pos) {
+    UndoInfo *undo = &pos->undoStack[--pos->undoCount];
+
+    pos->keyHistoryCount--;
+    pos->moveCount--;
+    pos->currentPlayer = 1 - pos->currentPlayer;
+    pos->lastMoveWasDoubleJump = undo->lastMoveWasDoubleJump;
+    pos->fiftyMoveCounter = undo->fiftyMoveCounter;
+    pos->positionKey = undo->positionKey;
+}
+
+// Play a game move for good. It cannot be taken back, so a game is not limited to the
+// undo stack, but it still counts for repetitions.
+void playMove(Position *pos, Move move) {
+    doMove(pos, move);
+    pos->undoCount--;
+    trimKeyHistory(pos);
+}
+
+void undoMove(Position *pos) {
+    UndoInfo *undo = &pos->undoStack[--pos->undoCount];
+    Move move = undo->move;
+
+    pos->keyHistoryCount--;
+    pos->moveCount--;
+    int fromX = SQUARE_X(MOVE_FROM(move)), fromY = SQUARE_Y(MOVE_FROM(move));
+    int toX = SQUARE_X(MOVE_TO(move)), toY = SQUARE_Y(MOVE_TO(move));
+
+    pos->currentPlayer = 1 - pos->currentPlayer;
+
+    switch (MOVE_KIND(move)) {
+        case MOVE_CASTLING:
+            setSquare(pos, fromX, fromY, pos->board[toX][toY]);
+            setSquare(pos, toX, toY, EMPTY);
+            if (toY > fromY) {
+                setSquare(pos, fromX, 7, pos->board[fromX][5]);
+                setSquare(pos, fromX, 5, EMPTY);
+            } else {
+                setSquare(pos, fromX, 0, pos->board[fromX][3]);
+                setSquare(pos, fromX, 3, EMPTY);
+            }
+            break;
+        case MOVE_EN_PASSANT:
+            setSquare(pos, fromX, fromY, pos->board[toX][toY]);
+            setSquare(pos, toX, toY, EMPTY);
+            setSquare(pos, fromX, toY, undo->captured);
+            break;
+        case MOVE_PROMOTION:
+            setSquare(pos, fromX, fromY, pieceChar(pos->currentPlayer, PAWN));
+            setSquare(pos, toX, toY, undo->captured);
+            break;
+        default:
+            setSquare(pos, fromX, fromY, pos->board[toX][toY]);
+            setSquare(pos, toX, toY, undo->captured);
+            break;
+    }
+
+    for (int color = 0; color < 2; color++) {
+        pos->canCastleKingside[color] = undo->canCastleKingside[color];
+        pos->canCastleQueenside[color] = undo->canCastleQueenside[color];
+        pos->lastPawnDoubleMove[color] = undo->lastPawnDoubleMove[color];
+    }
+    pos->lastMoveWasDoubleJump = undo->lastMoveWasDoubleJump;
+    pos->fiftyMoveCounter = undo->fiftyMoveCounter;
+    pos->positionKey = undo->positionKey;
+}
@@ -0,0 +1,92 @@
+#include <stdlib.h>
+#include "pawns.h"
+
+// By rows advanced from the pawn's starting row, one row before promotion at most
+static const int passedPawnBonus[6] = { 5, 10, 20, 35, 60, 100 };
+
+// Returns 0 if the memory cannot be allocated
+int pawnTableInit(PawnTable *table) {
+    // A zeroed entry is the correct analysis for key 0, the position without pawns
+    table->entries = calloc(PAWN_TABLE_ENTRIES, sizeof(PawnEntry));
+    table->mask = table->entries ? PAWN_TABLE_ENTRIES - 1 : 0;
+    return table->entries != NULL;
+}
+
+void pawnTableFree(PawnTable *table) {
+    free(table->entries);
+    table->entries = NULL;
+    table->mask = 0;
+}
+
+// Squares in front of a pawn of this color on its own and the neighbouring files
+static Bitboard frontSpan(int color, int sq) {
+    int x = SQUARE_X(sq), y = SQUARE_Y(sq);
+    Bitboard files = FILE_MASK(y);
+    Bitboard rows = 0;
+
+    if (y > 0) files |= FILE_MASK(y - 1);
+    if (y < 7) files |= FILE_MASK(y + 1);
+    if (color == 0) {
+        for (int row = 0; row < x; row++) rows |= ROW_MASK(row);
+    } else {
+        for (int row = x + 1; row < SIZE; row++) rows |= ROW_MASK(row);
+    }
+    return files & rows;
+}
+
+void analysePawns(const Position *pos, PawnEntry *entry) {
+    int score[2] = { 0, 0 };
+
+    entry->key = pos->pawnKey;
+    for (int color = 0; color < 2; color++) {
+        Bitboard ours = pos->pieceBitboards[color][PAWN];
+        Bitboard theirs = pos->pieceBitboards[1 - color][PAWN];
+        int homeRow = color == 0 ? 7 : 0;
+        int forward = color == 0 ? -1 : 1;
+
+        entry->passedFiles[color] = entry->isolatedFiles[color] = entry->doubledFiles[color] = 0;
+
+        for (int y = 0; y < SIZE; y++) {
+            int count = popCount(ours & FILE_MASK(y));
+            Bitboard neighbours = (y > 0 ? FILE_MASK(y - 1) : 0) | (y < 7 ? FILE_MASK(y + 1) : 0);
+
+            if (count > 1) {
+                entry->doubledFiles[color] |= 1 << y;
+                score[color] -= DOUBLED_PAWN_PENALTY * (count - 1);
+            }
+            if (count && !(ours & neighbours)) {
+                entry->isolatedFiles[color] |= 1 << y;
+                score[color] -= ISOLATED_PAWN_PENALTY * count;
+            }
+
+            // Pawns on the two rows in front of a king standing on this file
+            Bitboard shieldFiles = FILE_MASK(y) | neighbours;
+            entry->shield[color][y] = 10 * popCount(ours & shieldFiles & ROW_MASK(homeRow + forward)) +
+                                      5 * popCount(ours & shieldFiles & ROW_MASK(homeRow + 2 * forward));
+        }
+
+        Bitboard pawns = ours;
+        while (pawns) {
+            int sq = popLsb(&pawns);
+            if (theirs & frontSpan(color, sq)) continue;
+            // Only the front pawn of a doubled pair is passed
+            if (ours & frontSpan(color, sq) & FILE_MASK(SQUARE_Y(sq))) continue;
+
+            // setBoardFromFEN() keeps pawns off the end rows; the clamp guards the table anyway
+            int advanced = color == 0 ? 6 - SQUARE_X(sq) : SQUARE_X(sq) - 1;
+            if (advanced < 0) advanced = 0;
+            if (advanced > 5) advanced = 5;
+            entry->passedFiles[color] |= 1 << SQUARE_Y(sq);
+            score[color] += passedPawnBonus[advanced];
+        }
+    }
+
+    entry->score = score[1] - score[0];
+}
+
+// The analysis of the current pawn structure, from the table when it is there
+const PawnEntry *probePawnTable(PawnTable *table, const Position *pos) {
+    PawnEntry *entry = &table->entries[pos->pawnKey & table->mask];
+    if (entry->key != pos->pawnKey) analysePawns(pos, entry);
+    return entry;
+}
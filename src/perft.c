@@ -0,0 +1,166 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include "board.h"
+#include "moves.h"
+#include "movegen.h"
+#include "zobrist.h"
+#include "psqt.h"
+
+// Perft hash entry. check holds key ^ data, so an entry torn by two threads writing at once never matches.
+// data packs the node count above an 8-bit depth.
+typedef struct {
+    uint64_t check;
+    uint64_t data;
+} PerftEntry;
+
+static PerftEntry *perftTable;
+static uint64_t perftTableMask;
+
+static Position rootPosition;
+static MoveList rootMoves;
+static uint64_t rootCounts[MAX_MOVES];
+static int rootDepth;
+static int nextRootMove;
+
+static uint64_t perft(Position *pos, int depth) {
+    MoveList list;
+    generateLegalMoves(pos, &list);
+    if (depth == 1) return list.count;
+
+    uint64_t key = 0;
+    PerftEntry *entry = NULL;
+    if (perftTable) {
+        key = pos->positionKey;
+        entry = &perftTable[key & perftTableMask];
+        uint64_t data = entry->data;
+        if ((entry->check ^ data) == key && (int)(data & 0xFF) == depth) {
+            return data >> 8;
+        }
+    }
+
+    uint64_t nodes = 0;
+    for (int i = 0; i < list.count; i++) {
+        doMove(pos, list.moves[i]);
+        nodes += perft(pos, depth - 1);
+        undoMove(pos);
+    }
+
+    if (entry) {
+        uint64_t data = (nodes << 8) | (uint64_t)depth;
+        entry->data = data;
+        entry->check = key ^ data;
+    }
+    return nodes;
+}
+
+// Each worker sets up its own copy of the position and takes root moves until none are left
+static void *perftWorker(void *arg) {
+    Position pos = rootPosition;
+
+    (void)arg;
+    for (;;) {
+        int i = __sync_fetch_and_add(&nextRootMove, 1);
+        if (i >= rootMoves.count) break;
+
+        doMove(&pos, rootMoves.moves[i]);
+        rootCounts[i] = rootDepth > 1 ? perft(&pos, rootDepth - 1) : 1;
+        undoMove(&pos);
+    }
+    return NULL;
+}
+
+static double elapsedSeconds(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void usage(void) {
+    fprintf(stderr, "Usage: perft [-t threads] [-H hashMB] <depth> [startpos | fen]\n");
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    int threads = 1;
+    int hashMB = 0;
+    int arg = 1;
+
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (strcmp(argv[arg], "-t") == 0 && arg + 1 < argc) {
+            threads = atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "-H") == 0 && arg + 1 < argc) {
+            hashMB = atoi(argv[++arg]);
+        } else {
+            usage();
+        }
+    }
+    if (arg >= argc) usage();
+    rootDepth = atoi(argv[arg++]);
+    if (threads < 1) threads = 1;
+
+    // The FEN may arrive as one argument or spread over several
+    char fen[256] = "";
+    for (; arg < argc; arg++) {
+        if (strlen(fen) + strlen(argv[arg]) + 2 > sizeof(fen)) usage();
+        if (fen[0]) strcat(fen, " ");
+        strcat(fen, argv[arg]);
+    }
+    const char *rootFen = (fen[0] && strcmp(fen, "startpos") != 0) ? fen : START_FEN;
+
+    initBitboards();
+    initZobrist();
+    initPieceSquareTables();
+    if (!setBoardFromFEN(&rootPosition, rootFen)) {
+        fprintf(stderr, "Invalid FEN: %s\n", rootFen);
+        return 1;
+    }
+
+    if (hashMB > 0) {
+        uint64_t entries = 1;
+        while (entries * 2 * sizeof(PerftEntry) <= (uint64_t)hashMB << 20) entries *= 2;
+        perftTable = calloc(entries, sizeof(PerftEntry));
+        if (!perftTable) {
+            fprintf(stderr, "Could not allocate %d MB perft hash\n", hashMB);
+            return 1;
+        }
+        perftTableMask = entries - 1;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    uint64_t total = 0;
+    if (rootDepth <= 0) {
+        total = 1;
+    } else {
+        generateLegalMoves(&rootPosition, &rootMoves);
+
+        pthread_t workers[threads];
+        for (int i = 0; i < threads; i++) {
+            pthread_create(&workers[i], NULL, perftWorker, NULL);
+        }
+        for (int i = 0; i < threads; i++) {
+            pthread_join(workers[i], NULL);
+        }
+
+        for (int i = 0; i < rootMoves.count; i++) {
+            char moveStr[6];
+            moveToString(rootMoves.moves[i], moveStr);
+            printf("%s: %llu\n", moveStr, (unsigned long long)rootCounts[i]);
+            total += rootCounts[i];
+        }
+    }
+
+    double seconds = elapsedSeconds(&start);
+    printf("\nNodes: %llu\n", (unsigned long long)total);
+    printf("Time: %.3f s\n", seconds);
+    printf("NPS: %.0f\n", seconds > 0 ? total / seconds : 0.0);
+
+    free(perftTable);
+    return 0;
+}
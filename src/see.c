@@ -0,0 +1,65 @@
+#include "see.h"
+#include "moves.h"
+#include "ai.h"
+
+// Exchanges cannot be longer than the 32 pieces on the board
+#define MAX_EXCHANGE 32
+
+static const int exchangeValues[6] = { PAWN_VALUE, KNIGHT_VALUE, BISHOP_VALUE, ROOK_VALUE, QUEEN_VALUE, 0 };
+
+int staticExchange(const Position *pos, Move move) {
+    int from = MOVE_FROM(move), to = MOVE_TO(move);
+    char piece = pos->board[SQUARE_X(from)][SQUARE_Y(from)];
+    char victim = pos->board[SQUARE_X(to)][SQUARE_Y(to)];
+    int side = pieceColor(piece);
+    int onSquare = pieceType(piece);  // Type of the piece the next capture takes
+    Bitboard occupied = pos->occupiedBitboard ^ BIT(from);
+    int gain[MAX_EXCHANGE];
+    int depth = 0;
+
+    if (MOVE_KIND(move) == MOVE_CASTLING) return 0;
+
+    gain[0] = victim == EMPTY ? 0 : exchangeValues[pieceType(victim)];
+    if (MOVE_KIND(move) == MOVE_EN_PASSANT) {
+        gain[0] = PAWN_VALUE;
+        occupied ^= BIT(SQUARE(SQUARE_X(from), SQUARE_Y(to)));
+    } else if (MOVE_KIND(move) == MOVE_PROMOTION) {
+        onSquare = MOVE_PROMOTION_TYPE(move);
+        gain[0] += exchangeValues[onSquare] - PAWN_VALUE;
+    }
+
+    // Sliders behind a piece that captures join in once it has left the line
+    Bitboard diagonal = pos->pieceBitboards[0][BISHOP] | pos->pieceBitboards[1][BISHOP] |
+                        pos->pieceBitboards[0][QUEEN] | pos->pieceBitboards[1][QUEEN];
+    Bitboard straight = pos->pieceBitboards[0][ROOK] | pos->pieceBitboards[1][ROOK] |
+                        pos->pieceBitboards[0][QUEEN] | pos->pieceBitboards[1][QUEEN];
+    Bitboard attackers = (attackersTo(pos, to, occupied, 0) | attackersTo(pos, to, occupied, 1)) & occupied;
+
+    for (;;) {
+        side = 1 - side;
+        Bitboard ours = attackers & pos->colorBitboards[side];
+        if (!ours) break;
+
+        int type = PAWN;
+        while (!(ours & pos->pieceBitboards[side][type])) type++;
+        // The king may only take last, when nothing can take it back
+        if (type == KING && (attackers & pos->colorBitboards[1 - side])) break;
+        if (depth + 1 >= MAX_EXCHANGE) break;
+
+        depth++;
+        gain[depth] = exchangeValues[onSquare] - gain[depth - 1];
+        onSquare = type;
+
+        occupied ^= BIT(lsb(ours & pos->pieceBitboards[side][type]));
+        attackers |= (bishopAttacks(to, occupied) & diagonal) | (rookAttacks(to, occupied) & straight);
+        attackers &= occupied;
+    }
+
+    // Back up from the end of the sequence: each side stops rather than recapture at a loss
+    while (depth > 0) {
+        int stop = -gain[depth - 1];
+        gain[depth - 1] = -(stop > gain[depth] ? stop : gain[depth]);
+        depth--;
+    }
+    return gain[0];
+}
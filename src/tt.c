@@ -0,0 +1,102 @@
+#include <stdlib.h>
+#include <string.h>
+#include "tt.h"
+
+// data layout: move in bits 0-15, score in 16-47, depth in 48-55, bound in 56-57, generation in 58-63
+#define PACK(move, score, depth, bound, generation) \
+    ((uint64_t)(move) | ((uint64_t)(uint32_t)(score) << 16) | ((uint64_t)(uint8_t)(depth) << 48) | \
+     ((uint64_t)(bound) << 56) | ((uint64_t)(generation) << 58))
+#define DATA_MOVE(d) ((Move)((d) & 0xFFFF))
+#define DATA_SCORE(d) ((int)(int32_t)(uint32_t)((d) >> 16))
+#define DATA_DEPTH(d) ((int)(int8_t)(uint8_t)((d) >> 48))
+#define DATA_BOUND(d) ((int)(((d) >> 56) & 3))
+#define DATA_GENERATION(d) ((int)((d) >> 58))
+
+// Returns 0 and leaves the table empty if the memory cannot be allocated
+int ttInit(TranspositionTable *tt, int megabytes) {
+    uint64_t bytes = (uint64_t)(megabytes > 0 ? megabytes : 1) << 20;
+    uint64_t buckets = 1;
+
+    while (buckets * 2 * TT_BUCKET_SIZE * sizeof(TTEntry) <= bytes) buckets *= 2;
+
+    ttFree(tt);
+    tt->entries = calloc(buckets * TT_BUCKET_SIZE, sizeof(TTEntry));
+    if (!tt->entries) return 0;
+    tt->bucketMask = buckets - 1;
+    tt->generation = 0;
+    return 1;
+}
+
+void ttFree(TranspositionTable *tt) {
+    free(tt->entries);
+    tt->entries = NULL;
+    tt->bucketMask = 0;
+}
+
+void ttClear(TranspositionTable *tt) {
+    if (tt->entries) {
+        memset(tt->entries, 0, (tt->bucketMask + 1) * TT_BUCKET_SIZE * sizeof(TTEntry));
+    }
+    tt->generation = 0;
+}
+
+// Entries from older searches become the first to be replaced
+void ttNewSearch(TranspositionTable *tt) {
+    tt->generation = (tt->generation + 1) & 63;
+}
+
+static TTEntry *bucketOf(const TranspositionTable *tt, uint64_t key) {
+    return &tt->entries[(key & tt->bucketMask) * TT_BUCKET_SIZE];
+}
+
+int ttProbe(const TranspositionTable *tt, uint64_t key, TTData *data) {
+    if (!tt->entries) return 0;
+
+    TTEntry *bucket = bucketOf(tt, key);
+    for (int i = 0; i < TT_BUCKET_SIZE; i++) {
+        uint64_t packed = bucket[i].data;
+        if ((bucket[i].check ^ packed) == key && DATA_BOUND(packed) != BOUND_NONE) {
+            data->move = DATA_MOVE(packed);
+            data->score = DATA_SCORE(packed);
+            data->depth = DATA_DEPTH(packed);
+            data->bound = DATA_BOUND(packed);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Replaces the entry for the same position, otherwise the shallowest entry, preferring stale ones
+void ttStore(TranspositionTable *tt, uint64_t key, Move move, int score, int depth, int bound) {
+    if (!tt->entries) return;
+
+    TTEntry *bucket = bucketOf(tt, key);
+    TTEntry *replace = NULL;
+    int worst = 1 << 30;
+
+    for (int i = 0; i < TT_BUCKET_SIZE; i++) {
+        uint64_t packed = bucket[i].data;
+
+        if ((bucket[i].check ^ packed) == key) {
+            // Keep a deeper result for this position unless the new one is exact
+            if (bound != BOUND_EXACT && DATA_DEPTH(packed) > depth + 2 &&
+                DATA_GENERATION(packed) == tt->generation) {
+                return;
+            }
+            if (move == NO_MOVE) move = DATA_MOVE(packed);
+            replace = &bucket[i];
+            break;
+        }
+
+        int age = (tt->generation - DATA_GENERATION(packed)) & 63;
+        int worth = DATA_BOUND(packed) == BOUND_NONE ? -1000 : DATA_DEPTH(packed) - 8 * age;
+        if (worth < worst) {
+            worst = worth;
+            replace = &bucket[i];
+        }
+    }
+
+    uint64_t packed = PACK(move, score, depth, bound, tt->generation);
+    replace->data = packed;
+    replace->check = key ^ packed;
+}
@@ -0,0 +1,275 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include "uci.h"
+#include "board.h"
+#include "moves.h"
+#include "movegen.h"
+#include "ai.h"
+#include "tt.h"
+
+#define UCI_LINE_SIZE 8192
+
+// The search runs on its own thread so that "stop" and "isready" are answered meanwhile
+static pthread_t searchThread;
+static int searchRunning;
+static volatile int stopFlag;
+static SearchLimits goLimits;
+static Searcher engine;
+static Position position;       // Set by "position"
+static Position searchRoot;     // Copy handed to the search thread
+static SearchInfo lastReport;   // Last iteration of the running search, for its ponder move
+
+// Both threads write to stdout; every line is flushed at once for the GUI
+static void sendLine(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+static void sendLine(const char *format, ...) {
+    static pthread_mutex_t outputLock = PTHREAD_MUTEX_INITIALIZER;
+    va_list args;
+
+    pthread_mutex_lock(&outputLock);
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    putchar('\n');
+    fflush(stdout);
+    pthread_mutex_unlock(&outputLock);
+}
+
+// Coordinate notation, e.g. "e2e4" or "e7e8q", to the legal move it names
+static Move parseMove(const char *str) {
+    if (strlen(str) < 4 || str[0] < 'a' || str[0] > 'h' || str[2] < 'a' || str[2] > 'h' ||
+        str[1] < '1' || str[1] > '8' || str[3] < '1' || str[3] > '8') {
+        return NO_MOVE;
+    }
+
+    int from = SQUARE('8' - str[1], str[0] - 'a');
+    int to = SQUARE('8' - str[3], str[2] - 'a');
+    int promotionType = str[4] ? pieceType(str[4]) : QUEEN;
+    return findLegalMove(&position, from, to, promotionType);
+}
+
+static void reportIteration(const SearchInfo *info, void *data) {
+    char line[64 + MAX_DEPTH * 6];
+    char scoreText[32];
+    int length = 0;
+
+    (void)data;
+    lastReport = *info;
+    if (abs(info->score) >= MATE_BOUND) {
+        int plies = INFINITY_SCORE - abs(info->score);
+        int moves = (plies + 1) / 2;
+        snprintf(scoreText, sizeof(scoreText), "mate %d", info->score > 0 ? moves : -moves);
+    } else {
+        snprintf(scoreText, sizeof(scoreText), "cp %d", info->score);
+    }
+
+    for (int i = 0; i < info->pvLength; i++) {
+        char moveStr[6];
+        moveToString(info->pv[i], moveStr);
+        length += snprintf(line + length, sizeof(line) - length, " %s", moveStr);
+    }
+    line[length] = '\0';
+
+    sendLine("info depth %d score %s nodes %llu nps %llu time %lld pv%s",
+             info->depth, scoreText, (unsigned long long)info->nodes,
+             (unsigned long long)(info->timeMs > 0 ? info->nodes * 1000 / info->timeMs : info->nodes),
+             info->timeMs, line);
+#ifdef SEARCH_STATS
+    const SearchStats *stats = &info->stats;
+    sendLine("info string qnodes %llu cutoffs %llu firstmove %.1f%% tthits %.1f%% nullmove %llu cut %.1f%% "
+             "lmr %llu research %.1f%% ebf %.2f",
+             (unsigned long long)stats->qnodes, (unsigned long long)stats->betaCutoffs,
+             stats->betaCutoffs ? 100.0 * stats->firstMoveCutoffs / stats->betaCutoffs : 0.0,
+             stats->ttProbes ? 100.0 * stats->ttHits / stats->ttProbes : 0.0,
+             (unsigned long long)stats->nullMoves,
+             stats->nullMoves ? 100.0 * stats->nullMoveCutoffs / stats->nullMoves : 0.0,
+             (unsigned long long)stats->reductions,
+             stats->reductions ? 100.0 * stats->reSearches / stats->reductions : 0.0,
+             effectiveBranchingFactor(stats));
+#endif
+}
+
+static void *runSearch(void *arg) {
+    Move bestMove;
+    int score;
+    char moveStr[6] = "0000";
+
+    char ponderStr[6];
+
+    (void)arg;
+    lastReport.pvLength = 0;
+    if (searchPosition(&engine, &searchRoot, &goLimits, &bestMove, &score)) moveToString(bestMove, moveStr);
+
+    // An infinite search only reports its move once it was told to stop
+    while (goLimits.infinite && !stopFlag) {
+        struct timespec pause = { 0, 1000000 };
+        nanosleep(&pause, NULL);
+    }
+
+    // The reply the principal variation expects is the move to ponder on
+    if (lastReport.pvLength >= 2 && lastReport.pv[0] == bestMove) {
+        moveToString(lastReport.pv[1], ponderStr);
+        sendLine("bestmove %s ponder %s", moveStr, ponderStr);
+    } else {
+        sendLine("bestmove %s", moveStr);
+    }
+    return NULL;
+}
+
+static void waitForSearch(void) {
+    if (searchRunning) {
+        pthread_join(searchThread, NULL);
+        searchRunning = 0;
+    }
+}
+
+static void stopAndWait(void) {
+    stopFlag = 1;
+    waitForSearch();
+}
+
+// position startpos|fen <fen> [moves <move>...]
+static void handlePosition(char *args) {
+    char *moves = strstr(args, " moves");
+    if (moves) *moves = '\0';
+
+    if (strncmp(args, "startpos", 8) == 0) {
+        setBoardFromFEN(&position, START_FEN);
+    } else if (strncmp(args, "fen ", 4) == 0) {
+        if (!setBoardFromFEN(&position, args + 4)) {
+            sendLine("info string invalid fen %s", args + 4);
+            setBoardFromFEN(&position, START_FEN);
+            return;
+        }
+    } else {
+        return;
+    }
+
+    if (!moves) return;
+    for (char *token = strtok(moves + 6, " \t"); token; token = strtok(NULL, " \t")) {
+        Move move = parseMove(token);
+        if (move == NO_MOVE) {
+            sendLine("info string illegal move %s", token);
+            return;
+        }
+        playMove(&position, move);
+    }
+}
+
+static void handleGo(char *args) {
+    SearchLimits limits;
+    initSearchLimits(&limits);
+
+    for (char *token = strtok(args, " \t"); token; token = strtok(NULL, " \t")) {
+        char *value = NULL;
+        if (strcmp(token, "infinite") == 0) {
+            limits.infinite = 1;
+            continue;
+        }
+        if (strcmp(token, "ponder") == 0) continue;
+        if (!(value = strtok(NULL, " \t"))) break;
+
+        if (strcmp(token, "depth") == 0) limits.depth = atoi(value);
+        else if (strcmp(token, "nodes") == 0) limits.nodes = strtoull(value, NULL, 10);
+        else if (strcmp(token, "movetime") == 0) limits.moveTime = atoi(value);
+        else if (strcmp(token, "wtime") == 0) limits.time[0] = atoi(value);
+        else if (strcmp(token, "btime") == 0) limits.time[1] = atoi(value);
+        else if (strcmp(token, "winc") == 0) limits.increment[0] = atoi(value);
+        else if (strcmp(token, "binc") == 0) limits.increment[1] = atoi(value);
+        else if (strcmp(token, "movestogo") == 0) limits.movesToGo = atoi(value);
+    }
+
+    // A search is already finished or stopped here, so nobody reads the flag while it is reset
+    waitForSearch();
+    stopFlag = 0;
+    limits.stop = &stopFlag;
+    goLimits = limits;
+    searchRoot = position;
+
+    if (pthread_create(&searchThread, NULL, runSearch, NULL) == 0) {
+        searchRunning = 1;
+    } else {
+        sendLine("bestmove 0000");
+    }
+}
+
+// setoption name <name> value <value>
+static void handleSetOption(char *args) {
+    char *name = strstr(args, "name ");
+    char *value = strstr(args, " value ");
+    if (!name || !value) return;
+
+    *value = '\0';
+    name += 5;
+    value += 7;
+
+    if (strcmp(name, "Hash") == 0) {
+        int megabytes = atoi(value);
+        setHashSize(&engine, megabytes > 0 ? megabytes : 1);
+    } else if (strcmp(name, "Threads") == 0) {
+        setSearchThreads(&engine, atoi(value));
+    } else if (strcmp(name, "NullMove") == 0) {
+        engine.options.nullMove = strcmp(value, "true") == 0;
+    } else if (strcmp(name, "LMR") == 0) {
+        engine.options.lateMoveReductions = strcmp(value, "true") == 0;
+    } else {
+        sendLine("info string unknown option %s", name);
+    }
+}
+
+int uciLoop(int threads, FILE *statsOutput) {
+    char line[UCI_LINE_SIZE];
+
+    initSearcher(&engine);
+    setSearchThreads(&engine, threads);
+    setSearchInfoCallback(&engine, reportIteration, NULL);
+    setSearchStatsOutput(&engine, statsOutput);
+    setBoardFromFEN(&position, START_FEN);
+
+    while (fgets(line, sizeof(line), stdin)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        char *command = line;
+        while (*command == ' ' || *command == '\t') command++;
+        char *args = command + strcspn(command, " \t");
+        if (*args) *args++ = '\0';
+
+        if (strcmp(command, "uci") == 0) {
+            sendLine("id name GonAI");
+            sendLine("id author GonAI developers");
+            sendLine("option name Hash type spin default %d min 1 max 65536", DEFAULT_HASH_MB);
+            sendLine("option name Threads type spin default 1 min 1 max %d", MAX_SEARCH_THREADS);
+            sendLine("option name NullMove type check default true");
+            sendLine("option name LMR type check default true");
+            sendLine("uciok");
+        } else if (strcmp(command, "isready") == 0) {
+            sendLine("readyok");
+        } else if (strcmp(command, "ucinewgame") == 0) {
+            stopAndWait();
+            clearSearchTables(&engine);
+        } else if (strcmp(command, "position") == 0) {
+            stopAndWait();
+            handlePosition(args);
+        } else if (strcmp(command, "go") == 0) {
+            stopAndWait();
+            handleGo(args);
+        } else if (strcmp(command, "stop") == 0) {
+            stopAndWait();
+        } else if (strcmp(command, "setoption") == 0) {
+            stopAndWait();
+            handleSetOption(args);
+        } else if (strcmp(command, "d") == 0) {
+            displayBoard(&position);
+        } else if (strcmp(command, "quit") == 0) {
+            break;
+        }
+    }
+
+    stopAndWait();
+    freeSearcher(&engine);
+    return 0;
+}
@@ -0,0 +1,70 @@
+#include "zobrist.h"
+#include "board.h"
+
+uint64_t pieceKeys[2][6][64];
+uint64_t sideKey;
+uint64_t castleKingsideKeys[2];
+uint64_t castleQueensideKeys[2];
+uint64_t enPassantKeys[8];
+
+// splitmix64 with a fixed seed, so keys (and anything stored under them) are stable across runs
+static uint64_t nextKey(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+void initZobrist(void) {
+    uint64_t state = 0x1234ABCDULL;
+
+    for (int color = 0; color < 2; color++) {
+        for (int type = PAWN; type <= KING; type++) {
+            for (int sq = 0; sq < 64; sq++) {
+                pieceKeys[color][type][sq] = nextKey(&state);
+            }
+        }
+        castleKingsideKeys[color] = nextKey(&state);
+        castleQueensideKeys[color] = nextKey(&state);
+    }
+    for (int file = 0; file < 8; file++) {
+        enPassantKeys[file] = nextKey(&state);
+    }
+    sideKey = nextKey(&state);
+}
+
+// Key of the current position built from scratch
+uint64_t computePositionKey(const Position *pos) {
+    uint64_t key = 0;
+
+    for (int color = 0; color < 2; color++) {
+        for (int type = PAWN; type <= KING; type++) {
+            Bitboard pieces = pos->pieceBitboards[color][type];
+            while (pieces) {
+                key ^= pieceKeys[color][type][popLsb(&pieces)];
+            }
+        }
+    }
+    if (pos->currentPlayer) key ^= sideKey;
+
+    return key ^ castlingAndEnPassantKey(pos);
+}
+
+// The part of the key that doMove() cannot update square by square
+uint64_t castlingAndEnPassantKey(const Position *pos) {
+    uint64_t key = 0;
+
+    for (int color = 0; color < 2; color++) {
+        if (pos->canCastleKingside[color]) key ^= castleKingsideKeys[color];
+        if (pos->canCastleQueenside[color]) key ^= castleQueensideKeys[color];
+    }
+    // The en passant file only counts when a pawn could actually take, as in Polyglot, so the
+    // same position reached with and without a double push gets the same key
+    int us = pos->currentPlayer, them = 1 - us;
+    if (pos->lastMoveWasDoubleJump && pos->lastPawnDoubleMove[them] >= 0) {
+        int file = pos->lastPawnDoubleMove[them];
+        int target = SQUARE(us == 0 ? 2 : 5, file);
+        if (pawnAttacks[them][target] & pos->pieceBitboards[us][PAWN]) key ^= enPassantKeys[file];
+    }
+    return key;
+}
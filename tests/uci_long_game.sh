@@ -0,0 +1,15 @@
+#!/bin/sh
+# A "position startpos moves ..." list longer than the key history: 1200 plies of knights
+# going out and back. The engine must take it and still answer "go" with a move.
+engine=${1:-./chess}
+
+moves=$(awk 'BEGIN { for (i = 0; i < 300; i++) printf " g1f3 g8f6 f3g1 f6g8" }')
+output=$(printf 'uci\nposition startpos moves%s\ngo depth 3\nquit\n' "$moves" | "$engine" --uci) || {
+    echo "uci_long_game: engine failed" >&2
+    exit 1
+}
+echo "$output" | grep -q '^bestmove [a-h][1-8][a-h][1-8]' || {
+    echo "uci_long_game: no bestmove after a 1200-ply move list" >&2
+    exit 1
+}
+echo "uci_long_game: ok"